@@ -1,108 +1,166 @@
 #pragma once
 
+#include <condition_variable>
 #include <functional>
+#include <future>
+#include <mutex>
 #include <thread>
 
 #include "board.hpp"
+#include "evaluation_tables.hpp"
+#include "mate_solver.hpp"
+#include "search_stats.hpp"
+#include "spsc_queue.hpp"
+#include "tablebase.hpp"
+#include "transposition_table.hpp"
+
+struct SearchProgress {
+  static constexpr int k_max_pv_size{64};
+
+  // 1-based rank of the line in a multi-PV search.
+  int multi_pv{1};
+  int depth{};
+  int score{};
+  // Moves to the mate the mate solver or the tablebase proved, negative when
+  // getting mated, 0 for search results.
+  int mate{};
+  uint64_t nodes{};
+  uint64_t nps{};
+  std::chrono::milliseconds time{};
+  int pv_size{};
+  std::array<PackedMove, k_max_pv_size> pv{};
+};
+
+struct SearchLimits {
+  // Number of best root moves ranked by each iteration.
+  int multi_pv{1};
+  int depth{SearchProgress::k_max_pv_size - 1};
+  // Runs the proof-number mate solver on this many threads before the
+  // search, within half of the time and node limits. A proven mate is
+  // played right away, otherwise the search follows with what the solver
+  // left of them, its progress counting the solver's time and nodes.
+  unsigned mate_threads{};
+  // No new iteration starts after this, unlimited when empty.
+  std::optional<std::chrono::milliseconds> time{500ms};
+  // Stops the search as soon as it has searched this many nodes, playing the
+  // move of the last completed iteration. Unlike time it keeps searches
+  // repeatable.
+  std::optional<uint64_t> nodes;
+};
 
 class AI {
-  // clang-format off
-  static constexpr std::array k_pawn_table{
-    0,  0,  0,  0,  0,  0,  0,  0,
-   50, 50, 50, 50, 50, 50, 50, 50,
-   10, 10, 20, 30, 30, 20, 10, 10,
-    5,  5, 10, 25, 25, 10,  5,  5,
-    0,  0,  0, 20, 20,  0,  0,  0,
-    5, -5,-10,  0,  0,-10, -5,  5,
-    5, 10, 10,-20,-20, 10, 10,  5,
-    0,  0,  0,  0,  0,  0,  0,  0
-  };
+ public:
+  // Scores at least this far from 0 are mates.
+  static constexpr int k_mate_threshold{100000};
 
-  static constexpr std::array k_knight_table{
-    -50,-40,-30,-30,-30,-30,-40,-50,
-    -40,-20,  0,  0,  0,  0,-20,-40,
-    -30,  0, 10, 15, 15, 10,  0,-30,
-    -30,  5, 15, 20, 20, 15,  5,-30,
-    -30,  0, 15, 20, 20, 15,  0,-30,
-    -30,  5, 10, 15, 15, 10,  5,-30,
-    -40,-20,  0,  5,  5,  0,-20,-40,
-    -50,-40,-30,-30,-30,-30,-40,-50
-  };
+  AI() : AI(std::make_shared<TranspositionTable>()) {}
+  // AIs given the same table share what their searches learn.
+  explicit AI(std::shared_ptr<TranspositionTable> table)
+      : table_{std::move(table)}, worker_{std::bind_front(&AI::run, this)} {
+    LOG("AI", "Thread started");
+  }
 
-  static constexpr std::array k_bishop_table{
-    -20,-10,-10,-10,-10,-10,-10,-20,
-    -10,  0,  0,  0,  0,  0,  0,-10,
-    -10,  0,  5, 10, 10,  5,  0,-10,
-    -10,  5,  5, 10, 10,  5,  5,-10,
-    -10,  0, 10, 10, 10, 10,  0,-10,
-    -10, 10, 10, 10, 10, 10, 10,-10,
-    -10,  5,  0,  0,  0,  0,  5,-10,
-    -20,-10,-10,-10,-10,-10,-10,-20
-  };
+  ~AI() { stop(); }
 
-  static constexpr std::array k_rook_table{
-    0,  0,  0,  0,  0,  0,  0,  0,
-    5, 10, 10, 10, 10, 10, 10,  5,
-   -5,  0,  0,  0,  0,  0,  0, -5,
-   -5,  0,  0,  0,  0,  0,  0, -5,
-   -5,  0,  0,  0,  0,  0,  0, -5,
-   -5,  0,  0,  0,  0,  0,  0, -5,
-   -5,  0,  0,  0,  0,  0,  0, -5,
-    0,  0,  0,  5,  5,  0,  0,  0
-  };
+  AI(const AI&) = delete;
+  AI& operator=(const AI&) = delete;
 
-  static constexpr std::array k_queen_table{
-    -20,-10,-10, -5, -5,-10,-10,-20,
-    -10,  0,  0,  0,  0,  0,  0,-10,
-    -10,  0,  5,  5,  5,  5,  0,-10,
-     -5,  0,  5,  5,  5,  5,  0, -5,
-      0,  0,  5,  5,  5,  5,  0, -5,
-    -10,  5,  5,  5,  5,  5,  0,-10,
-    -10,  0,  5,  0,  0,  0,  0,-10,
-    -20,-10,-10, -5, -5,-10,-10,-20
-  };
+  AI(AI&&) = delete;
+  AI& operator=(AI&&) = delete;
 
-  static constexpr std::array k_king_table{
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -30,-40,-40,-50,-50,-40,-40,-30,
-    -20,-30,-30,-40,-40,-30,-30,-20,
-    -10,-20,-20,-20,-20,-20,-20,-10,
-     20, 20,  0,  0,  0,  0, 20, 20,
-     20, 30, 10,  0,  0, 10, 30, 20
-  };
-  // clang-format on
+  // Starts searching a copy of board, the future becomes ready with the best
+  // move once the search finishes or is stopped. With multi_pv above 1 each
+  // iteration also ranks the next best root moves, reported as separate
+  // progress lines.
+  std::future<Move> think(const Board& board, const SearchLimits& limits = {});
+  void stop() { stop_.store(true, std::memory_order_relaxed); }
 
- public:
-  AI() : worker_{std::bind_front(&AI::run, this)} {
-    LOG("AI", "Thread started");
-  }
+  // Forgets everything learned by earlier searches, only while not thinking.
+  // A shared table is cleared for all its AIs.
+  void clear();
+
+  // Endings in the tablebase are scored by it in the search, and at the root
+  // won and lost ones are played by distance to mate. Only while not
+  // thinking.
+  void set_tablebase(std::shared_ptr<const Tablebase> tablebase);
+
+  // Nodes of the last search, read after its future became ready.
+  [[nodiscard]] uint64_t get_nodes() const { return nodes_; }
 
-  void think(const Board& board);
+  // Snapshots published after each completed iteration. When they are not
+  // polled in time the ones in between are dropped, never the last.
+  std::optional<SearchProgress> poll_progress() { return progress_.pop(); }
 
-  Move get_best_move();
-  [[nodiscard]] bool is_thinking() const { return thinking_; }
-  [[nodiscard]] bool has_found_move() const { return found_move_; }
+  // Static evaluation from the side to move's point of view.
+  static int evaluate(const Board& board);
+  // Captures first, most valuable victim first, first_move before all.
+  static void order_moves(const Board& board, Moves& moves,
+                          PackedMove first_move = {});
 
  private:
+  static constexpr int k_infinity{1000000};
+  static constexpr int k_mate_score{500000};
+  static constexpr int k_max_ply{SearchProgress::k_max_pv_size};
+  static constexpr int k_min_aspiration_depth{4};
+  static constexpr int k_aspiration_window{50};
+  // The mate solver gets 1 / k_mate_solver_share of the limits.
+  static constexpr int k_mate_solver_share{2};
+
   void run(const std::stop_token& stop_token);
 
-  int search(int depth, int alpha, int beta);
+  // Both count the time from start and the nodes in nodes_ against the
+  // limits.
+  Move search_root(std::chrono::high_resolution_clock::time_point start);
+  std::optional<Move> solve_mate(
+      std::chrono::high_resolution_clock::time_point start);
+  std::optional<Move> probe_tablebase();
+  // The move to the quickest mate, or when getting mated to the slowest, and
+  // its score. Empty when a position after a move is not in the tablebase.
+  [[nodiscard]] std::optional<std::pair<PackedMove, int>> find_tablebase_move(
+      Board& board) const;
+  int aspiration_search(int depth, int previous_score);
+  int search_line(int depth, int alpha, int beta);
+  int search(int depth, int ply, int alpha, int beta);
   int quiesce(int alpha, int beta);
-  int evaluate() const;
-
-  void order_moves(Moves& moves) const;
+  [[nodiscard]] bool is_stopped() const {
+    return stop_.load(std::memory_order_relaxed);
+  }
 
+  static int get_tablebase_score(const Tablebase::Result& result) {
+    const int score{k_mate_score - result.plies};
+    return result.wdl == Tablebase::Wdl::Win    ? score
+           : result.wdl == Tablebase::Wdl::Loss ? -score
+                                                : 0;
+  }
   static int get_piece_value(PieceType type) {
-    return std::array{0, 10000, 1000, 350, 350, 525, 100}[to_underlying(type)];
+    return k_piece_values[to_underlying(type)];
   };
 
-  Move best_move_;
+  PackedMove best_move_{};
   Board board_;
-
-  std::atomic<bool> thinking_;
-  std::atomic<bool> found_move_;
+  uint64_t nodes_{};
+  SearchLimits limits_;
+  Moves excluded_moves_;
+  std::shared_ptr<TranspositionTable> table_;
+  // Created by the first search that asks for it.
+  std::unique_ptr<MateSolver> mate_solver_;
+  std::shared_ptr<const Tablebase> tablebase_;
+  SearchStats stats_;
+
+  // Triangular PV table, row ply holds the PV from ply onwards.
+  std::array<std::array<PackedMove, k_max_ply>, k_max_ply> pv_table_{};
+  std::array<int, k_max_ply + 1> pv_length_{};
+  std::array<PackedMove, k_max_ply> previous_pv_{};
+  int previous_pv_length_{};
+  bool follow_pv_{};
+
+  std::mutex mutex_;
+  std::condition_variable_any condition_;
+  bool has_request_{};
+  std::promise<Move> promise_;
+
+  std::atomic<bool> stop_;
+  SpscLatestQueue<SearchProgress, 64> progress_;
 
   std::jthread worker_;
 };
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <bit>
+
+#include "move.hpp"
+
+using Bitboard = uint64_t;
+
+constexpr Bitboard make_bitboard(int tile) {
+  assert(is_valid_tile(tile));
+  return Bitboard{1} << static_cast<unsigned>(tile);
+}
+
+constexpr bool has_tile(Bitboard bitboard, int tile) {
+  return (bitboard & make_bitboard(tile)) != 0;
+}
+
+constexpr int pop_tile(Bitboard& bitboard) {
+  assert(bitboard != 0);
+  const int tile{std::countr_zero(bitboard)};
+  bitboard &= bitboard - 1;
+  return tile;
+}
+
+// Tiles reached from tile by each (row, column) delta that stays on board.
+template <size_t N>
+constexpr Bitboard generate_leaper_attacks(
+    int tile, const std::array<std::array<int, 2>, N>& deltas) {
+  Bitboard attacks{};
+  for (const auto& [row_delta, column_delta] : deltas) {
+    const int row{get_tile_row(tile) + row_delta};
+    const int column{get_tile_column(tile) + column_delta};
+    if (0 <= row && row <= 7 && 0 <= column && column <= 7) {
+      attacks |= make_bitboard(8 * row + column);
+    }
+  }
+  return attacks;
+}
+
+template <size_t N>
+constexpr std::array<Bitboard, 64> generate_leaper_attack_table(
+    const std::array<std::array<int, 2>, N>& deltas) {
+  std::array<Bitboard, 64> table{};
+  for (int tile = 0; tile < 64; tile++) {
+    table[static_cast<size_t>(tile)] = generate_leaper_attacks(tile, deltas);
+  }
+  return table;
+}
+
+// clang-format off
+inline constexpr std::array<Bitboard, 64> k_knight_attacks{generate_leaper_attack_table<8>(
+    {{{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}}})};
+
+inline constexpr std::array<Bitboard, 64> k_king_attacks{generate_leaper_attack_table<8>(
+    {{{0, 1}, {1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}}})};
+
+// Indexed by get_color_index of the pawn's color.
+inline constexpr std::array<std::array<Bitboard, 64>, 2> k_pawn_attacks{
+    generate_leaper_attack_table<2>({{{-1, -1}, {-1, 1}}}),
+    generate_leaper_attack_table<2>({{{1, -1}, {1, 1}}})};
+// clang-format on
+
+static_assert(k_knight_attacks[0] == (make_bitboard(10) | make_bitboard(17)));
+static_assert(k_king_attacks[63] ==
+              (make_bitboard(54) | make_bitboard(55) | make_bitboard(62)));
+static_assert(k_pawn_attacks[1][8] == make_bitboard(17));
+static_assert(k_pawn_attacks[0][55] == (make_bitboard(46)));
@@ -1,28 +1,16 @@
 #pragma once
 
-#include "piece.hpp"
+#include <algorithm>
+#include <optional>
 
-constexpr bool is_valid_tile(int tile) { return 0 <= tile && tile <= 63; }
+#include "bitboard.hpp"
+#include "packed_position.hpp"
+#include "zobrist.hpp"
 
-constexpr int get_tile_row(int tile) {
-  assert(is_valid_tile(tile));
-  return static_cast<uint8_t>(tile) >> 3U;
-}
-
-constexpr int get_tile_column(int tile) {
-  assert(is_valid_tile(tile));
-  return static_cast<uint8_t>(tile) & 7U;
-}
-
-struct Move {
-  int tile{-1};
-  int target{-1};
-  PieceType promotion{};
-};
-
-struct Moves {
-  int size{};
-  std::array<Move, 256> data{};
+struct FenError {
+  // Position in the FEN where the problem was found.
+  size_t offset{};
+  std::string_view message;
 };
 
 class Board {
@@ -31,25 +19,128 @@ class Board {
   using CastlingRights = std::array<CastlingRight, 2>;
 
   struct MoveRecord {
-    Move move;
-    PieceType promotion{};
+    PackedMove move;
     Piece captured_piece{};
     CastlingRights castling_rights{};
     int enpassant_tile{};
+    int halfmove_clock{};
+    uint64_t key{};
     bool is_in_check_{};
     bool is_in_checkmate_{};
     bool is_in_draw_{};
   };
 
-  using Records = std::vector<MoveRecord>;
+  // Moves made with make_move, fixed capacity so make/undo never allocate.
+  class RecordStack {
+   public:
+    static constexpr int k_capacity{256};
+
+    RecordStack() = default;
+
+    RecordStack(const RecordStack& other) : size_{other.size_} {
+      std::copy_n(other.data_.begin(), size_, data_.begin());
+    }
+    RecordStack& operator=(const RecordStack& other) {
+      if (this != &other) {
+        size_ = other.size_;
+        std::copy_n(other.data_.begin(), size_, data_.begin());
+      }
+      return *this;
+    }
+
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+    [[nodiscard]] int size() const { return size_; }
+
+    MoveRecord& push(const MoveRecord& record) {
+      assert(size_ < k_capacity);
+      return data_[static_cast<size_t>(size_++)] = record;
+    }
+    void pop() {
+      assert(size_ > 0);
+      size_--;
+    }
+    void clear() { size_ = 0; }
+
+    [[nodiscard]] MoveRecord& back() {
+      assert(size_ > 0);
+      return data_[static_cast<size_t>(size_ - 1)];
+    }
+    [[nodiscard]] const MoveRecord& operator[](int index) const {
+      assert(0 <= index && index < size_);
+      return data_[static_cast<size_t>(index)];
+    }
+
+   private:
+    std::array<MoveRecord, k_capacity> data_;
+    int size_{};
+  };
+
+ public:
+  // Moves made with play_move. Immutable list nodes are shared between
+  // copies of the board, so copying it costs the same at any game length.
+  class Records {
+   public:
+    [[nodiscard]] bool empty() const { return head_ == nullptr; }
+    [[nodiscard]] int size() const { return empty() ? 0 : head_->size; }
+
+    [[nodiscard]] const MoveRecord& back() const {
+      assert(!empty());
+      return head_->record;
+    }
+
+    void push(const MoveRecord& record) {
+      head_ = std::make_shared<const Node>(record, head_, size() + 1);
+    }
+    void pop() {
+      assert(!empty());
+      head_ = head_->previous;
+    }
+
+   private:
+    struct Node {
+      MoveRecord record;
+      std::shared_ptr<const Node> previous;
+      int size{};
+    };
+
+   public:
+    // Walks from the most recent record to the first one.
+    class ReverseIterator {
+     public:
+      explicit ReverseIterator(const Node* node) : node_{node} {}
 
+      const MoveRecord& operator*() const { return node_->record; }
+      ReverseIterator& operator++() {
+        node_ = node_->previous.get();
+        return *this;
+      }
+      bool operator==(const ReverseIterator&) const = default;
+
+     private:
+      const Node* node_;
+    };
+
+    [[nodiscard]] ReverseIterator rbegin() const {
+      return ReverseIterator{head_.get()};
+    }
+    [[nodiscard]] ReverseIterator rend() const {
+      return ReverseIterator{nullptr};
+    }
+
+   private:
+
+    std::shared_ptr<const Node> head_;
+  };
+
+ private:
   static constexpr std::string_view k_initial_fen{
       "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"};
 
  public:
   Board();
 
-  void make_move(Move move);
+  void make_move(PackedMove move);
+  void play_move(PackedMove move);
   void undo();
 
   void generate_all_legal_moves(Moves& moves, bool only_captures = false);
@@ -58,12 +149,43 @@ class Board {
   [[nodiscard]] bool is_in_check() const { return is_in_check_; }
   [[nodiscard]] bool is_in_checkmate() const { return is_in_checkmate_; }
   [[nodiscard]] bool is_in_draw() const { return is_in_draw_; }
+  // The position occurred before since the last capture or pawn move.
+  [[nodiscard]] bool is_repetition() const { return count_repetitions(1) != 0; }
+
+  [[nodiscard]] bool is_threatened(int tile, PieceColor attacker_color) const;
+
+  // Check one move of the side to move against the rules without generating
+  // moves. A pseudo-legal move may leave the own king in check. Flags of a
+  // PackedMove are ignored, only its tiles and promotion count.
+  [[nodiscard]] bool is_pseudo_legal(Move move) const;
+  [[nodiscard]] bool is_legal(Move move) const;
 
   uint64_t perft(int depth);
 
-  void load_fen(std::string_view fen = k_initial_fen);
+  // Accepts four to six fields, missing clocks default to 0 and 1. On error
+  // the board holds the initial position.
+  std::optional<FenError> load_fen(std::string_view fen = k_initial_fen);
+  [[nodiscard]] std::string to_fen() const;
+
+  // Fails for positions to_packed could not have made, like ones from a
+  // corrupt file. The board then holds the initial position.
+  [[nodiscard]] bool load_packed(const PackedPosition& position);
+  // Empty with more than PackedPosition::k_max_pieces pieces.
+  [[nodiscard]] std::optional<PackedPosition> to_packed() const;
 
   [[nodiscard]] PieceColor get_turn() const { return turn_; }
+  [[nodiscard]] int get_halfmove_clock() const { return halfmove_clock_; }
+  [[nodiscard]] int get_fullmove_number() const { return fullmove_number_; }
+  [[nodiscard]] bool has_castling_rights() const {
+    return castling_rights_ != CastlingRights{};
+  }
+  // -1 unless the last move was a double pawn push.
+  [[nodiscard]] int get_enpassant_tile() const { return enpassant_tile_; }
+  // Whether a pawn of the side to move attacks the en passant tile. Only
+  // then is the en passant tile part of the key, so move orders reaching the
+  // same position get the same key.
+  [[nodiscard]] bool is_enpassant_possible() const;
+  [[nodiscard]] uint64_t get_key() const { return key_; }
   [[nodiscard]] Piece get_tile(int tile) const { return tiles_[tile]; }
   // clang-format off
   [[nodiscard]] PieceColor get_color(int tile) const { return get_piece_color(get_tile(tile)); }
@@ -71,25 +193,79 @@ class Board {
 
   [[nodiscard]] bool is_empty(int tile) const { return get_piece_type(get_tile(tile)) == PieceType::None; }
   [[nodiscard]] bool is_piece(int tile, PieceColor color, PieceType type) const { return get_color(tile) == color && get_type(tile) == type; }
+  [[nodiscard]] Bitboard get_bitboard(PieceColor color) const { return bitboards_[get_color_index(color)][0]; }
+  [[nodiscard]] Bitboard get_bitboard(PieceColor color, PieceType type) const { return bitboards_[get_color_index(color)][to_underlying(type)]; }
   // clang-format on
   [[nodiscard]] const Records& get_records() const { return records_; }
+  // Moves made with make_move and not undone yet, undo takes these first.
+  [[nodiscard]] int get_search_depth() const { return stack_.size(); }
 
  private:
-  void set_tile(int tile, Piece piece) { tiles_[tile] = piece; }
+  void set_tile(int tile, Piece piece) {
+    toggle_piece(tile, get_tile(tile));
+    toggle_piece(tile, piece);
+    tiles_[static_cast<size_t>(tile)] = piece;
+  }
+
+  void toggle_piece(int tile, Piece piece) {
+    const PieceType type{get_piece_type(piece)};
+    if (type == PieceType::None) {
+      return;
+    }
+    const uint8_t color_index{get_color_index(get_piece_color(piece))};
+    auto& bitboards{bitboards_[color_index]};
+    bitboards[0] ^= make_bitboard(tile);
+    bitboards[to_underlying(type)] ^= make_bitboard(tile);
+    key_ ^= k_zobrist_keys.pieces[color_index][to_underlying(type)]
+                                 [static_cast<size_t>(tile)];
+  }
+
+  void clear();
+  std::optional<FenError> set_fen(std::string_view fen);
+  void update_status();
 
-  void move(Move move);
+  [[nodiscard]] uint64_t get_state_key() const;
+  [[nodiscard]] int count_repetitions(int limit) const;
+
+  void move(PackedMove move);
+
+  template <PieceColor Color>
+  void generate_all_legal_moves(Moves& moves, bool only_captures);
+  template <PieceColor Color>
+  void generate_legal_moves(Moves& moves, int tile, bool only_captures);
+  template <PieceColor Color>
+  uint64_t perft(int depth);
+  template <PieceColor Color>
   bool has_legal_moves();
 
+  template <PieceColor Color>
   void generate_moves(Moves& moves, int tile) const;
-  [[nodiscard]] bool is_threatened(int tile, PieceColor attacker_color) const;
+  template <PieceColor Attacker>
+  [[nodiscard]] bool is_threatened(int tile) const;
+  // Like is_threatened after a move that left occupancy and the attacking
+  // pieces in attackers.
+  template <PieceColor Attacker>
+  [[nodiscard]] bool is_threatened(int tile, Bitboard occupancy,
+                                   Bitboard attackers) const;
+  template <PieceColor Color>
+  [[nodiscard]] bool is_pseudo_legal(Move move) const;
+  template <PieceColor Color>
+  [[nodiscard]] bool is_king_safe_after(Move move) const;
 
   PieceColor turn_{};
   CastlingRights castling_rights_{};
   std::array<int, 2> king_tiles_{};
   int enpassant_tile_{-1};
+  int halfmove_clock_{};
+  int fullmove_number_{1};
+  uint64_t key_{};
   std::array<Piece, 64> tiles_{};
+  // Indexed by color index and piece type, PieceType::None holds all pieces
+  // of the color.
+  std::array<std::array<Bitboard, 7>, 2> bitboards_{};
   bool is_in_check_{};
   bool is_in_checkmate_{};
   bool is_in_draw_{};
+  RecordStack stack_;
   Records records_;
 };
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+#include "common.hpp"
+
+// Blocking queue for any number of producers and consumers. push waits while
+// the queue holds capacity values, pop waits while it is empty. After close
+// push fails and pop drains the remaining values.
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity) : capacity_{capacity} {
+    assert(capacity != 0);
+  }
+
+  bool push(T value) {
+    {
+      std::unique_lock lock{mutex_};
+      not_full_.wait(lock, [this] {
+        return values_.size() < capacity_ || is_closed_;
+      });
+      if (is_closed_) {
+        return false;
+      }
+      values_.push_back(std::move(value));
+    }
+    not_empty_.notify_one();
+    return true;
+  }
+
+  // Empty once the queue is closed and drained.
+  std::optional<T> pop() {
+    std::optional<T> value;
+    {
+      std::unique_lock lock{mutex_};
+      not_empty_.wait(lock, [this] { return !values_.empty() || is_closed_; });
+      if (values_.empty()) {
+        return std::nullopt;
+      }
+      value = std::move(values_.front());
+      values_.pop_front();
+    }
+    not_full_.notify_one();
+    return value;
+  }
+
+  void close() {
+    {
+      const std::scoped_lock lock{mutex_};
+      is_closed_ = true;
+    }
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+ private:
+  size_t capacity_;
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::deque<T> values_;
+  bool is_closed_{};
+};
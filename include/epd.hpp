@@ -0,0 +1,44 @@
+#pragma once
+
+#include <optional>
+
+#include "mapped_file.hpp"
+
+// One EPD line. The views point into the line.
+struct EpdRecord {
+  // The four position fields, and the clocks of a FEN line, accepted by
+  // Board::load_fen.
+  std::string_view fen;
+  // Operand of the id opcode without its quotes.
+  std::string_view id;
+  // Space separated SAN operands of the bm and am opcodes.
+  std::string_view best_moves;
+  std::string_view avoid_moves;
+  // Operand of the c9 opcode without its quotes, a game result like 1-0.
+  std::string_view result;
+};
+
+// Splits an EPD or FEN line into its position and the id, bm, am and c9
+// operations, others are skipped. Fails when the line has fewer than four
+// fields.
+std::optional<EpdRecord> parse_epd(std::string_view line);
+
+// Streams the records of a memory mapped EPD file. Records stay valid as long
+// as the reader.
+class EpdReader {
+ public:
+  explicit EpdReader(const std::filesystem::path& path) : file_{path} {}
+
+  [[nodiscard]] bool is_open() const { return file_.is_open(); }
+
+  // Next record, skipping empty lines and logging malformed ones.
+  std::optional<EpdRecord> next();
+
+  // 1-based line of the last returned record.
+  [[nodiscard]] size_t get_line_number() const { return line_number_; }
+
+ private:
+  MappedFile file_;
+  size_t offset_{};
+  size_t line_number_{};
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+
+// Generated by chess-tune. The piece values are indexed by PieceType, the
+// tables read like a board seen from their side with its back rank last.
+
+// clang-format off
+inline constexpr std::array k_piece_values{0, 10000, 1000, 350, 350, 525, 100};
+
+inline constexpr std::array k_pawn_table{
+   0,   0,   0,   0,   0,   0,   0,   0,
+  50,  50,  50,  50,  50,  50,  50,  50,
+  10,  10,  20,  30,  30,  20,  10,  10,
+   5,   5,  10,  25,  25,  10,   5,   5,
+   0,   0,   0,  20,  20,   0,   0,   0,
+   5,  -5, -10,   0,   0, -10,  -5,   5,
+   5,  10,  10, -20, -20,  10,  10,   5,
+   0,   0,   0,   0,   0,   0,   0,   0
+};
+
+inline constexpr std::array k_knight_table{
+ -50, -40, -30, -30, -30, -30, -40, -50,
+ -40, -20,   0,   0,   0,   0, -20, -40,
+ -30,   0,  10,  15,  15,  10,   0, -30,
+ -30,   5,  15,  20,  20,  15,   5, -30,
+ -30,   0,  15,  20,  20,  15,   0, -30,
+ -30,   5,  10,  15,  15,  10,   5, -30,
+ -40, -20,   0,   5,   5,   0, -20, -40,
+ -50, -40, -30, -30, -30, -30, -40, -50
+};
+
+inline constexpr std::array k_bishop_table{
+ -20, -10, -10, -10, -10, -10, -10, -20,
+ -10,   0,   0,   0,   0,   0,   0, -10,
+ -10,   0,   5,  10,  10,   5,   0, -10,
+ -10,   5,   5,  10,  10,   5,   5, -10,
+ -10,   0,  10,  10,  10,  10,   0, -10,
+ -10,  10,  10,  10,  10,  10,  10, -10,
+ -10,   5,   0,   0,   0,   0,   5, -10,
+ -20, -10, -10, -10, -10, -10, -10, -20
+};
+
+inline constexpr std::array k_rook_table{
+   0,   0,   0,   0,   0,   0,   0,   0,
+   5,  10,  10,  10,  10,  10,  10,   5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+  -5,   0,   0,   0,   0,   0,   0,  -5,
+   0,   0,   0,   5,   5,   0,   0,   0
+};
+
+inline constexpr std::array k_queen_table{
+ -20, -10, -10,  -5,  -5, -10, -10, -20,
+ -10,   0,   0,   0,   0,   0,   0, -10,
+ -10,   0,   5,   5,   5,   5,   0, -10,
+  -5,   0,   5,   5,   5,   5,   0,  -5,
+   0,   0,   5,   5,   5,   5,   0,  -5,
+ -10,   5,   5,   5,   5,   5,   0, -10,
+ -10,   0,   5,   0,   0,   0,   0, -10,
+ -20, -10, -10,  -5,  -5, -10, -10, -20
+};
+
+inline constexpr std::array k_king_table{
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -30, -40, -40, -50, -50, -40, -40, -30,
+ -20, -30, -30, -40, -40, -30, -30, -20,
+ -10, -20, -20, -20, -20, -20, -20, -10,
+  20,  20,   0,   0,   0,   0,  20,  20,
+  20,  30,  10,   0,   0,  10,  30,  20
+};
+// clang-format on
@@ -20,7 +20,8 @@ class Game {
   static constexpr glm::vec3 k_light_position{0.0F, 40.0F, 0.0F};
 
  public:
-  explicit Game(GLFWwindow* window);
+  // The AI searches with table, to share it with other processes.
+  Game(GLFWwindow* window, std::shared_ptr<TranspositionTable> table);
 
   void run();
 
@@ -50,7 +51,7 @@ class Game {
   bool is_cursor_active() const { return glfwGetInputMode(renderer_.get_window(), GLFW_CURSOR) == GLFW_CURSOR_NORMAL; }
   void enable_cursor() { glfwSetInputMode(renderer_.get_window(), GLFW_CURSOR, GLFW_CURSOR_NORMAL); mouse_last_position_ = mouse_last_position_real_; }
   void disable_cursor() { glfwSetInputMode(renderer_.get_window(), GLFW_CURSOR, GLFW_CURSOR_DISABLED); mouse_last_position_real_ = mouse_last_position_; }
-  void clear_selections() { selectable_tiles_ = {}; selected_tile_ = -1; }
+  void clear_selections() { selected_tile_ = -1; }
 
   void process_camera_movement();
   void set_camera_target_position(const glm::vec3& position) { camera_target_position_ = position; is_camera_moving_ = true; }
@@ -65,10 +66,16 @@ class Game {
   glm::vec2 mouse_last_position_real_{mouse_last_position_};
   bool first_mouse_input_{true};
 
-  [[nodiscard]] bool is_selectable_tile(int tile) const;
+  void update_legal_targets();
+  // clang-format off
+  [[nodiscard]] Bitboard get_selectable_tiles() const { return selected_tile_ == -1 ? 0 : legal_targets_[static_cast<size_t>(selected_tile_)]; }
+  [[nodiscard]] bool is_selectable_tile(int tile) const { return (get_selectable_tiles() & make_bitboard(tile)) != 0; }
+  // clang-format on
 
   Board board_;
-  Moves selectable_tiles_;
+  // Targets of the legal moves from every tile, updated whenever the position
+  // changes.
+  std::array<Bitboard, 64> legal_targets_{};
   int selected_tile_{-1};
 
   struct ActiveMove {
@@ -89,8 +96,17 @@ class Game {
   bool is_ai_turn() const { return board_.get_turn() == ai_color_; }
 
   AI ai_;
+  std::future<Move> ai_move_;
+  std::future<Move> cancelled_ai_move_;
   PieceColor ai_color_{};
 
+  bool is_ai_thinking() const { return ai_move_.valid(); }
+  // Stops the search and drops its move, for when the board changes under it.
+  // The search winds down in the background, is_ai_ready tells when the AI
+  // can think again.
+  void cancel_ai_move();
+  bool is_ai_ready();
+
   bool game_over_{};
 
   Transform calculate_piece_transform(int tile) const;
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <span>
+
+#include "common.hpp"
+
+// A whole file mapped into memory. is_open is false when the file could not
+// be opened or mapped.
+class MappedFile {
+ public:
+  enum class Mode : uint8_t { Read, ReadWrite };
+
+  MappedFile() = default;
+  // ReadWrite creates the file when it does not exist.
+  explicit MappedFile(const std::filesystem::path& path,
+                      Mode mode = Mode::Read);
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  // Changes the file size and maps it again, only in ReadWrite mode.
+  bool resize(size_t size);
+  void close();
+
+  [[nodiscard]] bool is_open() const { return is_open_; }
+  [[nodiscard]] std::span<const std::byte> get_bytes() const {
+    return {data_, size_};
+  }
+  [[nodiscard]] std::span<std::byte> get_writable_bytes() {
+    assert(mode_ == Mode::ReadWrite);
+    return {data_, size_};
+  }
+  [[nodiscard]] std::string_view get_text() const {
+    return {reinterpret_cast<const char*>(data_), size_};
+  }
+
+ private:
+  bool map();
+  void unmap();
+
+  bool is_open_{};
+  Mode mode_{};
+  std::byte* data_{};
+  size_t size_{};
+#ifdef _WIN32
+  void* file_{};
+  void* mapping_{};
+#else
+  int file_{-1};
+#endif
+};
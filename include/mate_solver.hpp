@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "board.hpp"
+
+// Proves or disproves a forced mate by the side to move with depth-first
+// proof-number search. It needs no depth limit and follows the lines where
+// the defender has the fewest replies, so long forcing mates that alpha-beta
+// would have to search to their full depth are found early.
+//
+// Proofs are exact. Repetitions and draws count as failed attacks where they
+// are met, so a disproof reached through one may miss a mate.
+class MateSolver {
+ public:
+  enum class Result : uint8_t { Unknown, Mate, NoMate };
+
+  struct Limits {
+    unsigned threads{1};
+    // Unlimited when empty.
+    std::optional<std::chrono::milliseconds> time;
+    std::optional<uint64_t> nodes;
+  };
+
+  struct Solution {
+    Result result{};
+    uint64_t nodes{};
+    std::chrono::milliseconds time{};
+    // For a mate the line to it, the defender picking the longest defence
+    // the proof knows of.
+    std::vector<PackedMove> pv;
+  };
+
+  // The node table keeps what earlier solves proved. When it fills up the
+  // entries that took the least work to compute are collected, proofs last.
+  explicit MateSolver(size_t size_mb = 64);
+
+  // Threads share the node table and steer away from nodes the others are
+  // in. stop ends the solve early, like the limits.
+  Solution solve(const Board& board, const Limits& limits,
+                 const std::atomic<bool>& stop);
+  // Only while not solving.
+  void clear();
+
+ private:
+  static constexpr uint32_t k_infinity{1U << 30U};
+  static constexpr size_t k_cluster_size{4};
+  static constexpr size_t k_lock_count{1024};
+
+  struct Node {
+    uint32_t proof{};
+    uint32_t disproof{};
+    // Distance to mate of a proven node.
+    uint16_t plies{};
+  };
+
+  struct Entry {
+    uint64_t key{};
+    Node node;
+    // Threads searching below the node.
+    uint16_t searchers{};
+    // Nodes searched to compute node, saturated.
+    uint32_t work{};
+
+    // No node is both proven and disproven.
+    [[nodiscard]] bool is_empty() const {
+      return node.proof == 0 && node.disproof == 0;
+    }
+  };
+
+  struct Child;
+  struct Worker;
+
+  [[nodiscard]] std::optional<Entry> probe(uint64_t key);
+  void begin_search(uint64_t key, const Node& node);
+  // Stores the result of a search, started with begin_search or not.
+  void end_search(uint64_t key, const Node& node, uint64_t work,
+                  bool is_started);
+  // Expects the lock of key's cluster to be held.
+  Entry& find_or_add(uint64_t key, const Node& node, bool& is_added);
+  void collect_garbage();
+
+  Node search(Worker& worker, int ply, uint32_t proof_threshold,
+              uint32_t disproof_threshold);
+  std::vector<Child> expand(Worker& worker, int ply);
+  void count_node(Worker& worker);
+  [[nodiscard]] bool is_stopped() const {
+    return is_stopped_.load(std::memory_order_relaxed) ||
+           stop_->load(std::memory_order_relaxed);
+  }
+  std::vector<PackedMove> find_pv(Board board);
+
+  [[nodiscard]] size_t get_cluster(uint64_t key) const {
+    return key & (entries_.size() - k_cluster_size);
+  }
+  [[nodiscard]] std::mutex& get_lock(size_t cluster) {
+    return locks_[cluster / k_cluster_size % k_lock_count];
+  }
+
+  std::vector<Entry> entries_;
+  std::vector<std::mutex> locks_{k_lock_count};
+  std::atomic<size_t> size_;
+  std::mutex garbage_mutex_;
+
+  // State of the running solve.
+  PieceColor attacker_{};
+  Limits limits_;
+  std::chrono::high_resolution_clock::time_point start_;
+  const std::atomic<bool>* stop_{};
+  std::atomic<bool> is_stopped_;
+  std::atomic<uint64_t> nodes_;
+};
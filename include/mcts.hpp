@@ -0,0 +1,126 @@
+#pragma once
+
+#include <random>
+
+#include "ai.hpp"
+
+struct MctsOptions {
+  unsigned threads{1};
+  size_t tree_mb{256};
+  // Leaves are scored by the evaluation at the end of a random playout this
+  // many plies long, 0 scores them by the evaluation right away. Playouts
+  // end early MctsAI::k_max_plies from the root.
+  int playout_plies{};
+};
+
+// Monte Carlo tree search with PUCT selection, an alternative to AI behind
+// the same interface. Priors come from the evaluation after each move.
+// Threads descend one shared tree, each adding a virtual loss along its path
+// so the others spread out. Nodes live in an arena, and the subtree below
+// the next root is compacted and kept for the next search.
+class MctsAI {
+ public:
+  // The tree and the playouts stay within this many plies of the root, which
+  // leaves room in the board's move stack for the quiescence at the end.
+  static constexpr int k_max_plies{232};
+
+  MctsAI() : MctsAI(MctsOptions{}) {}
+  explicit MctsAI(const MctsOptions& options);
+
+  ~MctsAI() { stop(); }
+
+  MctsAI(const MctsAI&) = delete;
+  MctsAI& operator=(const MctsAI&) = delete;
+
+  MctsAI(MctsAI&&) = delete;
+  MctsAI& operator=(MctsAI&&) = delete;
+
+  // Like AI::think, the most visited move is played. nodes limits the
+  // playouts, depth and multi_pv do not apply, so without a time or node
+  // limit the search runs until stopped.
+  std::future<Move> think(const Board& board, const SearchLimits& limits = {});
+  void stop() { stop_.store(true, std::memory_order_relaxed); }
+
+  // Forgets the tree, only while not thinking.
+  void clear();
+
+  // Playouts of the last search, read after its future became ready.
+  [[nodiscard]] uint64_t get_nodes() const { return nodes_; }
+
+  // Snapshots of the most visited line. When they are not polled in time the
+  // ones in between are dropped, never the last.
+  std::optional<SearchProgress> poll_progress() { return progress_.pop(); }
+
+ private:
+  static constexpr double k_exploration{1.5};
+  // Centipawns that make a move's prior e times as large.
+  static constexpr float k_prior_temperature{200.0F};
+  static constexpr auto k_poll_interval{5ms};
+  static constexpr auto k_progress_interval{250ms};
+
+  struct Node {
+    enum class State : uint8_t { Leaf, Expanding, Expanded };
+
+    PackedMove move;
+    uint8_t child_count{};
+    std::atomic<State> state;
+    float prior{};
+    uint32_t first_child{};
+    std::atomic<uint32_t> visits;
+    std::atomic<uint32_t> virtual_losses;
+    // Results from the view of the side that played move, 1 for a win.
+    std::atomic<double> value_sum;
+
+    void reset(PackedMove new_move, float new_prior) {
+      move = new_move;
+      child_count = 0;
+      state.store(State::Leaf, std::memory_order_relaxed);
+      prior = new_prior;
+      first_child = 0;
+      visits.store(0, std::memory_order_relaxed);
+      virtual_losses.store(0, std::memory_order_relaxed);
+      value_sum.store(0.0, std::memory_order_relaxed);
+    }
+  };
+
+  void run(const std::stop_token& stop_token);
+
+  Move search_root();
+  void reuse_tree();
+  void search(uint64_t seed);
+  void playout(Board& board, std::vector<uint32_t>& path,
+               std::mt19937_64& random);
+  bool expand(Node& node, Board& board);
+  [[nodiscard]] uint32_t select_child(const Node& node) const;
+  double evaluate_leaf(Board& board, int ply, std::mt19937_64& random) const;
+  void publish_progress(std::chrono::milliseconds time);
+  [[nodiscard]] bool is_searching() const {
+    return is_searching_.load(std::memory_order_relaxed) &&
+           !stop_.load(std::memory_order_relaxed) &&
+           (!limits_.nodes ||
+            playouts_.load(std::memory_order_relaxed) < *limits_.nodes);
+  }
+
+  MctsOptions options_;
+  std::unique_ptr<Node[]> tree_;
+  size_t capacity_{};
+  std::atomic<size_t> size_;
+  uint32_t root_{};
+  uint64_t root_key_{};
+
+  Board board_;
+  SearchLimits limits_;
+  std::atomic<bool> is_searching_;
+  std::atomic<uint64_t> playouts_;
+  uint64_t nodes_{};
+
+  std::mutex mutex_;
+  std::condition_variable_any condition_;
+  bool has_request_{};
+  std::promise<Move> promise_;
+
+  std::atomic<bool> stop_;
+  SpscLatestQueue<SearchProgress, 64> progress_;
+
+  std::jthread worker_;
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+#include "piece.hpp"
+
+constexpr bool is_valid_tile(int tile) { return 0 <= tile && tile <= 63; }
+
+constexpr int get_tile_row(int tile) {
+  assert(is_valid_tile(tile));
+  return static_cast<uint8_t>(tile) >> 3U;
+}
+
+constexpr int get_tile_column(int tile) {
+  assert(is_valid_tile(tile));
+  return static_cast<uint8_t>(tile) & 7U;
+}
+
+struct Move {
+  int tile{-1};
+  int target{-1};
+  PieceType promotion{};
+};
+
+// Coordinate notation, e.g. "e2e4" or "e7e8q".
+inline std::string to_string(const Move& move) {
+  std::string string{static_cast<char>('a' + get_tile_column(move.tile)),
+                     static_cast<char>('1' + get_tile_row(move.tile)),
+                     static_cast<char>('a' + get_tile_column(move.target)),
+                     static_cast<char>('1' + get_tile_row(move.target))};
+  switch (move.promotion) {
+    case PieceType::Queen:
+      string += 'q';
+      break;
+    case PieceType::Rook:
+      string += 'r';
+      break;
+    case PieceType::Bishop:
+      string += 'b';
+      break;
+    case PieceType::Knight:
+      string += 'n';
+      break;
+    default:
+      break;
+  }
+  return string;
+}
+
+// Reads coordinate notation as written by to_string.
+inline std::optional<Move> parse_move(std::string_view text) {
+  if (text.size() != 4 && text.size() != 5) {
+    return std::nullopt;
+  }
+  auto parse_tile = [](char column, char row) {
+    return column >= 'a' && column <= 'h' && row >= '1' && row <= '8'
+               ? 8 * (row - '1') + (column - 'a')
+               : -1;
+  };
+  Move move{parse_tile(text[0], text[1]), parse_tile(text[2], text[3])};
+  if (move.tile == -1 || move.target == -1) {
+    return std::nullopt;
+  }
+  if (text.size() == 5) {
+    switch (text[4]) {
+      case 'q':
+        move.promotion = PieceType::Queen;
+        break;
+      case 'r':
+        move.promotion = PieceType::Rook;
+        break;
+      case 'b':
+        move.promotion = PieceType::Bishop;
+        break;
+      case 'n':
+        move.promotion = PieceType::Knight;
+        break;
+      default:
+        return std::nullopt;
+    }
+  }
+  return move;
+}
+
+// 6 bits tile, 6 bits target and 4 bits flags. Capture and special move
+// flags are only set by the move generator, a move converted from Move
+// carries just its promotion.
+class PackedMove {
+ public:
+  enum Flag : uint8_t {
+    Quiet,
+    DoublePawnPush,
+    ShortCastling,
+    LongCastling,
+    Capture,
+    EnpassantCapture,
+    Promotion = 8,
+  };
+
+  PackedMove() = default;
+  constexpr PackedMove(int tile, int target, uint8_t flags = Quiet)
+      : data_{static_cast<uint16_t>(static_cast<unsigned>(tile) |
+                                    static_cast<unsigned>(target) << 6U |
+                                    static_cast<unsigned>(flags) << 12U)} {
+    assert(is_valid_tile(tile) && is_valid_tile(target) && flags < 16);
+  }
+  constexpr PackedMove(const Move& move)
+      : PackedMove(move.tile, move.target,
+                   move.promotion == PieceType::None
+                       ? uint8_t{Quiet}
+                       : make_promotion_flags(move.promotion)) {}
+
+  constexpr operator Move() const {
+    return {get_tile(), get_target(), get_promotion()};
+  }
+
+  [[nodiscard]] constexpr int get_tile() const { return data_ & 63U; }
+  [[nodiscard]] constexpr int get_target() const { return data_ >> 6U & 63U; }
+  [[nodiscard]] constexpr uint8_t get_flags() const {
+    return static_cast<uint8_t>(data_ >> 12U);
+  }
+
+  [[nodiscard]] constexpr PieceType get_promotion() const {
+    if (!is_promotion()) {
+      return PieceType::None;
+    }
+    return std::array{PieceType::Knight, PieceType::Bishop, PieceType::Rook,
+                      PieceType::Queen}[get_flags() & 3U];
+  }
+
+  // clang-format off
+  [[nodiscard]] constexpr bool is_null() const { return data_ == 0; }
+  [[nodiscard]] constexpr bool is_capture() const { return (get_flags() & Capture) != 0; }
+  [[nodiscard]] constexpr bool is_promotion() const { return (get_flags() & Promotion) != 0; }
+  [[nodiscard]] constexpr bool is_enpassant() const { return get_flags() == EnpassantCapture; }
+  [[nodiscard]] constexpr bool is_castling() const { return get_flags() == ShortCastling || get_flags() == LongCastling; }
+  // clang-format on
+
+  [[nodiscard]] constexpr uint16_t get_data() const { return data_; }
+
+  friend constexpr bool operator==(PackedMove, PackedMove) = default;
+
+  static constexpr uint8_t make_promotion_flags(PieceType type,
+                                                bool is_capture = false) {
+    assert(type == PieceType::Knight || type == PieceType::Bishop ||
+           type == PieceType::Rook || type == PieceType::Queen);
+    const auto index{static_cast<uint8_t>(
+        type == PieceType::Knight   ? 0U
+        : type == PieceType::Bishop ? 1U
+        : type == PieceType::Rook   ? 2U
+                                    : 3U)};
+    const auto capture{static_cast<uint8_t>(is_capture ? Capture : Quiet)};
+    return static_cast<uint8_t>(Promotion | capture | index);
+  }
+
+ private:
+  uint16_t data_;
+};
+
+static_assert(sizeof(PackedMove) == 2);
+
+struct Moves {
+  static constexpr int k_capacity{256};
+
+  // Left uninitialized, only the first size moves are ever read.
+  int size{};
+  std::array<PackedMove, k_capacity> data;
+
+  void add(PackedMove move) {
+    assert(size < k_capacity);
+    data[static_cast<size_t>(size++)] = move;
+  }
+
+  [[nodiscard]] auto begin() { return data.begin(); }
+  [[nodiscard]] auto end() { return data.begin() + size; }
+  [[nodiscard]] auto begin() const { return data.begin(); }
+  [[nodiscard]] auto end() const { return data.begin() + size; }
+};
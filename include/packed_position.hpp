@@ -0,0 +1,32 @@
+#pragma once
+
+#include "bitboard.hpp"
+
+// Fixed-size position for datasets, stored in files as a plain array in
+// native little-endian layout.
+struct PackedPosition {
+  // 16 of each color, as many as a legal position has.
+  static constexpr int k_max_pieces{32};
+
+  Bitboard occupancy{};
+  // 4-bit codes of the occupied tiles from a1 upwards, low nibble first. The
+  // code is the piece type with bit 3 set for black.
+  std::array<uint8_t, k_max_pieces / 2> pieces{};
+  // Bit 0 is set when black is to move, bits 1 to 4 hold the castling rights
+  // packed like the Zobrist index.
+  uint8_t state{};
+  int8_t enpassant_tile{-1};
+  uint8_t halfmove_clock{};
+  // Labels for datasets, Board ignores them. result is 1, 0 or -1 from
+  // white's point of view, score is in centipawns from white's point of view.
+  int8_t result{};
+  uint16_t fullmove_number{1};
+  int16_t score{};
+
+  friend bool operator==(const PackedPosition&,
+                         const PackedPosition&) = default;
+};
+
+static_assert(sizeof(PackedPosition) == 32);
+static_assert(std::is_trivially_copyable_v<PackedPosition>);
+static_assert(std::endian::native == std::endian::little);
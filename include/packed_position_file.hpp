@@ -0,0 +1,50 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "packed_position.hpp"
+
+// Memory mapped file of packed positions. is_open is false when the file
+// could not be mapped or its size is not a whole number of positions.
+class PackedPositionReader {
+ public:
+  explicit PackedPositionReader(const std::filesystem::path& path);
+
+  [[nodiscard]] bool is_open() const { return file_.is_open(); }
+  [[nodiscard]] std::span<const PackedPosition> get_positions() const {
+    const std::span<const std::byte> bytes{file_.get_bytes()};
+    return {reinterpret_cast<const PackedPosition*>(bytes.data()),
+            bytes.size() / sizeof(PackedPosition)};
+  }
+
+ private:
+  MappedFile file_;
+};
+
+// Appends packed positions to a memory mapped file, growing it in chunks.
+// close trims the file to the written positions.
+class PackedPositionWriter {
+  static constexpr size_t k_min_capacity{size_t{1} << 16U};
+
+ public:
+  // Replaces the file.
+  explicit PackedPositionWriter(const std::filesystem::path& path);
+  ~PackedPositionWriter() { close(); }
+
+  PackedPositionWriter(const PackedPositionWriter&) = delete;
+  PackedPositionWriter& operator=(const PackedPositionWriter&) = delete;
+
+  PackedPositionWriter(PackedPositionWriter&&) = default;
+  PackedPositionWriter& operator=(PackedPositionWriter&&) = default;
+
+  [[nodiscard]] bool is_open() const { return file_.is_open(); }
+  [[nodiscard]] size_t size() const { return size_; }
+
+  bool write(const PackedPosition& position) { return write({&position, 1}); }
+  bool write(std::span<const PackedPosition> positions);
+  void close();
+
+ private:
+  MappedFile file_;
+  size_t size_{};
+  size_t capacity_{};
+};
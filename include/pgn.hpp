@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <span>
+#include <thread>
+
+#include "mapped_file.hpp"
+#include "san.hpp"
+
+// One game of a PGN file. The views point into the file.
+struct PgnGame {
+  // 0-based position of the game in the file.
+  size_t index{};
+  std::string_view tags;
+  std::string_view movetext;
+
+  // Value of the tag without quotes, empty when missing.
+  [[nodiscard]] std::string_view get_tag(std::string_view name) const;
+  // 1, 0 or -1 from white's point of view, empty when unknown.
+  [[nodiscard]] std::optional<int> get_result() const;
+};
+
+// Splits a memory mapped PGN file into games without parsing the moves.
+// Games stay valid as long as the reader.
+class PgnReader {
+ public:
+  explicit PgnReader(const std::filesystem::path& path) : file_{path} {}
+
+  [[nodiscard]] bool is_open() const { return file_.is_open(); }
+
+  std::optional<PgnGame> next();
+
+ private:
+  MappedFile file_;
+  size_t offset_{};
+  size_t game_count_{};
+};
+
+// Called with every position of a game and the move played from it, the
+// final position comes with a null move.
+using PgnVisitor =
+    std::function<void(const PgnGame& game, const Board& board,
+                       PackedMove move)>;
+
+// Plays the moves of game from its FEN tag or the initial position. Fails
+// on the first move that is not legal, after visiting the positions before.
+bool replay_pgn_game(const PgnGame& game, Board& board,
+                     const PgnVisitor& visitor);
+
+struct PgnReplayResult {
+  size_t games{};
+  size_t positions{};
+  size_t failed_games{};
+};
+
+// Replays games on thread_count threads in no particular order, visitor has
+// to be thread safe.
+PgnReplayResult replay_pgn_games(
+    std::span<const PgnGame> games, const PgnVisitor& visitor,
+    unsigned thread_count = std::thread::hardware_concurrency());
+
+using PgnTag = std::pair<std::string_view, std::string_view>;
+
+// The game of moves played on board from its starting position, moves made
+// with make_move are left out. The seven tag roster defaults to "?" and the
+// result is taken from the board unless given in tags.
+std::string to_pgn(const Board& board, std::span<const PgnTag> tags = {});
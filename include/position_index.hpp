@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <thread>
+
+#include "mapped_file.hpp"
+#include "move.hpp"
+
+// How often a move was played from a position and how those games ended.
+struct PositionMoveStats {
+  uint64_t key{};
+  uint32_t count{};
+  uint32_t white_wins{};
+  uint32_t draws{};
+  uint32_t black_wins{};
+  // Null for games that ended in the position.
+  PackedMove move{};
+  std::array<uint8_t, 6> reserved{};
+};
+
+// A game, by its 0-based number in the PGN file, that reached a position.
+struct PositionGame {
+  uint64_t key{};
+  uint32_t game{};
+  uint32_t reserved{};
+};
+
+static_assert(sizeof(PositionMoveStats) == 32 && sizeof(PositionGame) == 16);
+
+// Memory mapped index from Zobrist keys to move statistics and games, both
+// sorted by key and searched by binary search.
+class PositionIndex {
+ public:
+  explicit PositionIndex(const std::filesystem::path& path);
+
+  [[nodiscard]] bool is_open() const { return file_.is_open(); }
+
+  [[nodiscard]] std::span<const PositionMoveStats> find_moves(
+      uint64_t key) const;
+  [[nodiscard]] std::span<const PositionGame> find_games(uint64_t key) const;
+
+ private:
+  MappedFile file_;
+  std::span<const PositionMoveStats> moves_;
+  std::span<const PositionGame> games_;
+};
+
+// Replays the games of a PGN file on thread_count threads, each sorting its
+// positions into runs of about run_size records on disk, and merges the runs
+// into the index. Games with an illegal move are left out entirely.
+bool build_position_index(
+    const std::filesystem::path& pgn_path,
+    const std::filesystem::path& index_path,
+    unsigned thread_count = std::thread::hardware_concurrency(),
+    size_t run_size = size_t{1} << 22U);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <optional>
+
+#include "board.hpp"
+
+// Standard algebraic notation, e.g. "Nbd7", "exd6", "e8=Q+" or "O-O-O". The
+// board is only used for generating moves and is left unchanged.
+std::string to_san(Board& board, PackedMove move);
+
+// Accepts check, mate and annotation suffixes, "0-0" castling and promotions
+// without "=". Fails unless exactly one legal move matches.
+std::optional<PackedMove> parse_san(Board& board, std::string_view san);
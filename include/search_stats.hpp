@@ -0,0 +1,56 @@
+#pragma once
+
+#include "common.hpp"
+
+// #define ENABLE_SEARCH_STATS
+
+// Counters of a single search. With ENABLE_SEARCH_STATS undefined every
+// method is empty and the calls compile away.
+class SearchStats {
+ public:
+#ifdef ENABLE_SEARCH_STATS
+  static constexpr bool k_enabled{true};
+#else
+  static constexpr bool k_enabled{false};
+#endif
+
+  struct Depth {
+    int depth{};
+    uint64_t nodes{};
+    std::chrono::microseconds time{};
+  };
+
+  void clear() {
+    if constexpr (k_enabled) {
+      *this = {};
+    }
+  }
+
+  // clang-format off
+  void add_quiescence_node() { if constexpr (k_enabled) { quiescence_nodes_++; } }
+  void add_table_probe(bool is_hit) { if constexpr (k_enabled) { table_probes_++; table_hits_ += is_hit ? 1 : 0; } }
+  void add_table_store(bool is_stored) { if constexpr (k_enabled) { table_store_attempts_++; table_stores_ += is_stored ? 1 : 0; } }
+  void add_beta_cutoff(bool is_first_move) { if constexpr (k_enabled) { beta_cutoffs_++; first_move_beta_cutoffs_ += is_first_move ? 1 : 0; } }
+  // clang-format on
+
+  // nodes and time are cumulative since the start of the search.
+  void add_depth(int depth, uint64_t nodes, std::chrono::microseconds time) {
+    if constexpr (k_enabled) {
+      depths_.push_back({depth, nodes, time});
+    }
+  }
+
+  // One line of JSON, empty when disabled.
+  [[nodiscard]] std::string to_json(uint64_t nodes,
+                                    std::chrono::microseconds time) const;
+
+ private:
+  uint64_t quiescence_nodes_{};
+  uint64_t table_probes_{};
+  uint64_t table_hits_{};
+  uint64_t table_store_attempts_{};
+  uint64_t table_stores_{};
+  uint64_t beta_cutoffs_{};
+  uint64_t first_move_beta_cutoffs_{};
+  std::vector<Depth> depths_;
+};
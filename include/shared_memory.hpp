@@ -0,0 +1,37 @@
+#pragma once
+
+#include <span>
+
+#include "common.hpp"
+
+// A named block of memory mapped by every process that opens the same name.
+// The first one creates it zeroed with its size, later ones map it with the
+// size it already has. On POSIX systems it outlives the processes until the
+// system restarts or it is removed from /dev/shm, on Windows it goes with the
+// last one. is_open is false when it could not be created or mapped.
+class SharedMemory {
+ public:
+  SharedMemory() = default;
+  SharedMemory(std::string_view name, size_t size);
+  ~SharedMemory() { close(); }
+
+  SharedMemory(const SharedMemory&) = delete;
+  SharedMemory& operator=(const SharedMemory&) = delete;
+
+  SharedMemory(SharedMemory&& other) noexcept { *this = std::move(other); }
+  SharedMemory& operator=(SharedMemory&& other) noexcept;
+
+  void close();
+
+  [[nodiscard]] bool is_open() const { return data_ != nullptr; }
+  [[nodiscard]] std::span<std::byte> get_bytes() const {
+    return {data_, size_};
+  }
+
+ private:
+  std::byte* data_{};
+  size_t size_{};
+#ifdef _WIN32
+  void* mapping_{};
+#endif
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+
+#include "common.hpp"
+
+// Lock-free queue for exactly one producer thread and one consumer thread.
+// push fails instead of blocking when the queue is full.
+template <typename T, size_t Capacity>
+class SpscQueue {
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+  static constexpr size_t k_cache_line_size{64};
+
+ public:
+  bool push(const T& value) {
+    const size_t tail{tail_.load(std::memory_order_relaxed)};
+    if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    buffer_[tail & (Capacity - 1)] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::optional<T> pop() {
+    const size_t head{head_.load(std::memory_order_relaxed)};
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return std::nullopt;
+    }
+    T value{buffer_[head & (Capacity - 1)]};
+    head_.store(head + 1, std::memory_order_release);
+    return value;
+  }
+
+ private:
+  std::array<T, Capacity> buffer_{};
+  alignas(k_cache_line_size) std::atomic<size_t> head_{};
+  alignas(k_cache_line_size) std::atomic<size_t> tail_{};
+};
+
+// SpscQueue that never loses the newest value. A push to a full queue
+// replaces the last value that did not fit instead of failing, dropping the
+// values between it and the queued ones, so the last value popped is always
+// the last one pushed. Neither side ever blocks.
+//
+// Values that do not fit go through a triple buffer: the producer writes its
+// back buffer and swaps it with the middle one, the consumer swaps the middle
+// one with its front buffer when it holds a new value. While there is a new
+// value in the middle the producer leaves the queue alone, so it stays newer
+// than everything queued.
+template <typename T, size_t Capacity>
+class SpscLatestQueue {
+  static constexpr uint8_t k_new_value{4};
+
+ public:
+  void push(const T& value) {
+    if ((middle_.load(std::memory_order_relaxed) & k_new_value) == 0 &&
+        queue_.push(value)) {
+      return;
+    }
+    buffers_[back_] = value;
+    back_ = static_cast<uint8_t>(
+        middle_.exchange(static_cast<uint8_t>(back_ | k_new_value),
+                         std::memory_order_acq_rel) &
+        3U);
+  }
+
+  std::optional<T> pop() {
+    // Checked before the queue: the producer may fill the queue and the
+    // middle buffer again right after the queue is found empty.
+    const bool has_new_value{
+        (middle_.load(std::memory_order_acquire) & k_new_value) != 0};
+    if (auto value = queue_.pop()) {
+      return value;
+    }
+    if (!has_new_value) {
+      return std::nullopt;
+    }
+    front_ = static_cast<uint8_t>(
+        middle_.exchange(front_, std::memory_order_acq_rel) & 3U);
+    return buffers_[front_];
+  }
+
+ private:
+  SpscQueue<T, Capacity> queue_;
+  std::array<T, 3> buffers_{};
+  // Index of the middle buffer, with k_new_value set while the consumer has
+  // not taken it.
+  std::atomic<uint8_t> middle_{1};
+  // Owned by the producer and the consumer.
+  uint8_t back_{0};
+  uint8_t front_{2};
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <thread>
+
+#include "board.hpp"
+#include "mapped_file.hpp"
+
+// Win, draw or loss and the distance to mate of every position of endings
+// with up to four pieces, generated by retrograde analysis. Each material
+// has a memory-mapped file named after it, such as KRKP for a rook against
+// a pawn, which also answers for the colors swapped. Castling and en
+// passant are not part of the tables, positions with either are not probed
+// and a double push is scored as if it gave no en passant capture.
+class Tablebase {
+ public:
+  static constexpr int k_max_pieces{4};
+
+  enum class Wdl : uint8_t { Loss, Draw, Win };
+
+  // From the side to move's point of view. plies counts to the mate for a
+  // win or a loss, 0 when the side to move is mated.
+  struct Result {
+    Wdl wdl{};
+    int plies{};
+  };
+
+  // Maps every table file in directory and returns how many were loaded.
+  size_t load(const std::filesystem::path& directory);
+  // Generates the table of a material such as "KRKP", and first every
+  // missing one its captures and promotions lead to, writing them to
+  // directory. Fails on a malformed material or a write error.
+  bool generate(std::string_view material,
+                const std::filesystem::path& directory,
+                unsigned thread_count = std::thread::hardware_concurrency());
+
+  [[nodiscard]] std::optional<Result> probe(const Board& board) const;
+  [[nodiscard]] size_t size() const { return tables_.size(); }
+
+ private:
+  struct Position {
+    std::array<int, k_max_pieces> tiles{};
+    PieceColor turn{};
+  };
+
+  // Positions are indexed by the side to move and the tiles of the pieces,
+  // the white king's limited to one half of the board, or with no pawns to
+  // one eighth, by mirroring the board.
+  struct Table {
+    Table(const std::array<Piece, k_max_pieces>& new_pieces,
+          int new_piece_count);
+
+    [[nodiscard]] size_t get_index(const Position& position) const;
+    [[nodiscard]] Position get_position(size_t index) const;
+    // Expects board to have the material of the table, or with is_flipped
+    // its colors swapped.
+    [[nodiscard]] Position get_position(const Board& board,
+                                        bool is_flipped) const;
+
+    // Kings first, white then black.
+    std::array<Piece, k_max_pieces> pieces{};
+    int piece_count{};
+    bool has_pawns{};
+    // Positions per side to move.
+    size_t size{};
+    MappedFile file;
+    // 2 bits per position, 0 for illegal ones and 1 plus the Wdl otherwise.
+    const uint8_t* wdl{};
+    const uint8_t* plies{};
+  };
+
+  struct Lookup {
+    size_t table{};
+    // The table has the colors of the board swapped.
+    bool is_flipped{};
+  };
+
+  struct Generator;
+
+  bool generate(Table table, const std::filesystem::path& directory,
+                unsigned thread_count);
+  bool open(const std::filesystem::path& path);
+  [[nodiscard]] std::optional<Lookup> find(uint64_t material_key) const;
+
+  std::vector<Table> tables_;
+  std::unordered_map<uint64_t, Lookup> lookups_;
+};
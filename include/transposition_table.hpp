@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <optional>
+
+#include "move.hpp"
+#include "shared_memory.hpp"
+
+// Safe to share between threads. A slot holds two words written
+// independently, with the key stored XORed with the entry, so a slot torn by
+// concurrent stores fails the key check instead of returning a mix. The same
+// holds between processes, so a table can also live in named shared memory.
+class TranspositionTable {
+ public:
+  enum class Bound : uint8_t { None, Exact, Lower, Upper };
+
+  struct Entry {
+    int32_t score{};
+    PackedMove move{};
+    uint8_t depth{};
+    Bound bound{};
+  };
+
+  static_assert(sizeof(Entry) == 8);
+
+  explicit TranspositionTable(size_t size_mb = 16)
+      : private_slots_(get_slot_count(size_mb * 1024 * 1024)),
+        slots_{private_slots_} {}
+  // Opens the table of every process using shared_name, which keeps the size
+  // of the process that created it. Falls back to a private table when the
+  // shared memory is not available.
+  TranspositionTable(std::string_view shared_name, size_t size_mb)
+      : shared_memory_{shared_name, size_mb * 1024 * 1024} {
+    const std::span<std::byte> bytes{shared_memory_.get_bytes()};
+    if (!shared_memory_.is_open() || get_slot_count(bytes.size()) == 0) {
+      LOGF("TranspositionTable", "Failed to open shared memory {}",
+           shared_name);
+      shared_memory_.close();
+      private_slots_ = std::vector<Slot>(get_slot_count(size_mb * 1024 * 1024));
+      slots_ = private_slots_;
+      return;
+    }
+    // Zeroed memory holds empty slots.
+    slots_ = {reinterpret_cast<Slot*>(bytes.data()),
+              get_slot_count(bytes.size())};
+  }
+
+  TranspositionTable(const TranspositionTable&) = delete;
+  TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+  TranspositionTable(TranspositionTable&&) = delete;
+  TranspositionTable& operator=(TranspositionTable&&) = delete;
+
+  [[nodiscard]] bool is_shared() const { return shared_memory_.is_open(); }
+
+  [[nodiscard]] std::optional<Entry> probe(uint64_t key) const {
+    const Slot& slot{get_slot(key)};
+    const uint64_t data{slot.data.load(std::memory_order_relaxed)};
+    const auto entry{std::bit_cast<Entry>(data)};
+    if ((slot.check.load(std::memory_order_relaxed) ^ data) != key ||
+        entry.bound == Bound::None) {
+      return std::nullopt;
+    }
+    return entry;
+  }
+
+  // Returns whether the entry was written.
+  bool store(uint64_t key, int depth, int score, Bound bound,
+             PackedMove move) {
+    Slot& slot{get_slot(key)};
+    const uint64_t data{slot.data.load(std::memory_order_relaxed)};
+    const auto entry{std::bit_cast<Entry>(data)};
+    const bool is_same_key{
+        (slot.check.load(std::memory_order_relaxed) ^ data) == key};
+    if (is_same_key && depth < entry.depth && bound != Bound::Exact) {
+      return false;
+    }
+    if (is_same_key && move.is_null()) {
+      move = entry.move;
+    }
+    const auto new_data{std::bit_cast<uint64_t>(
+        Entry{score, move, static_cast<uint8_t>(depth), bound})};
+    slot.check.store(key ^ new_data, std::memory_order_relaxed);
+    slot.data.store(new_data, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Leaves a shared table alone, it holds the searches of other processes.
+  void clear() {
+    if (is_shared()) {
+      return;
+    }
+    for (Slot& slot : slots_) {
+      slot.check.store(0, std::memory_order_relaxed);
+      slot.data.store(0, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;
+  };
+
+  static_assert(sizeof(Slot) == 16);
+  // Atomics that are not lock-free would not work across processes.
+  static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+  static size_t get_slot_count(size_t size) {
+    return std::bit_floor(size / sizeof(Slot));
+  }
+
+  [[nodiscard]] Slot& get_slot(uint64_t key) {
+    return slots_[key & (slots_.size() - 1)];
+  }
+  [[nodiscard]] const Slot& get_slot(uint64_t key) const {
+    return slots_[key & (slots_.size() - 1)];
+  }
+
+  std::vector<Slot> private_slots_;
+  SharedMemory shared_memory_;
+  std::span<Slot> slots_;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "piece.hpp"
+
+struct ZobristKeys {
+  // Indexed by color index, piece type and tile.
+  std::array<std::array<std::array<uint64_t, 64>, 7>, 2> pieces{};
+  // Indexed by both colors' castling rights packed into 4 bits.
+  std::array<uint64_t, 16> castling_rights{};
+  // Indexed by the column of the en passant tile.
+  std::array<uint64_t, 8> enpassant_columns{};
+  // Present when black is to move.
+  uint64_t black_turn{};
+};
+
+constexpr ZobristKeys generate_zobrist_keys() {
+  uint64_t state{0x9E3779B97F4A7C15U};
+  auto next = [&state] {  // SplitMix64
+    uint64_t z{state += 0x9E3779B97F4A7C15U};
+    z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9U;
+    z = (z ^ (z >> 27U)) * 0x94D049BB133111EBU;
+    return z ^ (z >> 31U);
+  };
+
+  ZobristKeys keys;
+  for (auto& types : keys.pieces) {
+    for (auto& tiles : types) {
+      for (uint64_t& key : tiles) {
+        key = next();
+      }
+    }
+  }
+  for (uint64_t& key : keys.castling_rights) {
+    key = next();
+  }
+  for (uint64_t& key : keys.enpassant_columns) {
+    key = next();
+  }
+  keys.black_turn = next();
+  return keys;
+}
+
+inline constexpr ZobristKeys k_zobrist_keys{generate_zobrist_keys()};
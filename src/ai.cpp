@@ -4,74 +4,363 @@
 
 #include "board.hpp"
 
-void AI::think(const Board& board) {
-  assert(!thinking_);
-  board_ = board;
-  found_move_ = false;
-  thinking_ = true;
+std::future<Move> AI::think(const Board& board, const SearchLimits& limits) {
+  assert(limits.multi_pv >= 1);
+  assert(1 <= limits.depth && limits.depth < k_max_ply);
+  std::future<Move> future;
+  {
+    const std::scoped_lock lock{mutex_};
+    assert(!has_request_);
+    board_ = board;
+    limits_ = limits;
+    promise_ = {};
+    future = promise_.get_future();
+    stop_ = false;
+    has_request_ = true;
+  }
+  condition_.notify_one();
+  return future;
 }
 
-Move AI::get_best_move() {
-  assert(found_move_);
-  found_move_ = false;
-  return best_move_;
+void AI::clear() {
+  const std::scoped_lock lock{mutex_};
+  assert(!has_request_);
+  table_->clear();
+  if (mate_solver_) {
+    mate_solver_->clear();
+  }
+}
+
+void AI::set_tablebase(std::shared_ptr<const Tablebase> tablebase) {
+  const std::scoped_lock lock{mutex_};
+  assert(!has_request_);
+  tablebase_ = std::move(tablebase);
 }
 
 void AI::run(const std::stop_token& stop_token) {
-  while (!stop_token.stop_requested()) {
-    std::this_thread::sleep_for(1s);
-    if (thinking_ && !found_move_) {
-      auto start{std::chrono::high_resolution_clock::now()};
-      int score{-1000000};
-      for (int i = 1;; i++) {
-        score = std::max(score, search(i, -1000000, 1000000));
-        auto now{std::chrono::high_resolution_clock::now()};
-        auto ms{
-            std::chrono::duration_cast<std::chrono::milliseconds>(now - start)};
-        LOGF("AI", "Depth: {} Time: {}ms", i, ms.count());
-        if (score >= 100000 || ms.count() > 500) {
-          break;
-        }
+  while (true) {
+    {
+      std::unique_lock lock{mutex_};
+      if (!condition_.wait(lock, stop_token, [this] { return has_request_; })) {
+        break;
       }
-      thinking_ = false;
-      found_move_ = true;
+    }
+    // The mate solver and the search share the limits, each counting from
+    // here.
+    const auto start{std::chrono::high_resolution_clock::now()};
+    nodes_ = 0;
+    std::optional<Move> best_move;
+    if (tablebase_) {
+      best_move = probe_tablebase();
+    }
+    if (!best_move && limits_.mate_threads != 0) {
+      best_move = solve_mate(start);
+    }
+    if (!best_move) {
+      best_move = search_root(start);
+    }
+    {
+      const std::scoped_lock lock{mutex_};
+      has_request_ = false;
+      promise_.set_value(*best_move);
     }
   }
   LOG("AI", "Thread stopped");
 }
 
-int AI::search(int depth, int alpha, int beta) {
-  if (depth == 0 || board_.is_in_checkmate() || board_.is_in_draw()) {
+Move AI::search_root(std::chrono::high_resolution_clock::time_point start) {
+  stats_.clear();
+  previous_pv_length_ = 0;
+
+  PackedMove best_move{};
+  int best_score{};
+  for (int depth = 1;; depth++) {
+    excluded_moves_.size = 0;
+    for (int line = 1; line <= limits_.multi_pv; line++) {
+      const int score{line == 1 ? aspiration_search(depth, best_score)
+                                : search_line(depth, -k_infinity, k_infinity)};
+      if (is_stopped() || best_move_.is_null()) {
+        break;
+      }
+      if (line == 1) {
+        best_move = best_move_;
+        best_score = score;
+        previous_pv_length_ = pv_length_[0];
+        std::copy_n(pv_table_[0].begin(), previous_pv_length_,
+                    previous_pv_.begin());
+      }
+      excluded_moves_.add(best_move_);
+
+      const auto time{std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::high_resolution_clock::now() - start)};
+      SearchProgress progress{.multi_pv = line,
+                              .depth = depth,
+                              .score = score,
+                              .nodes = nodes_,
+                              .nps = nodes_ * 1000 /
+                                     static_cast<uint64_t>(time.count() + 1),
+                              .time = time,
+                              .pv_size = pv_length_[0]};
+      std::copy_n(pv_table_[0].begin(), pv_length_[0], progress.pv.begin());
+      progress_.push(progress);
+    }
+
+    const auto time{std::chrono::high_resolution_clock::now() - start};
+    if (!is_stopped()) {
+      stats_.add_depth(
+          depth, nodes_,
+          std::chrono::duration_cast<std::chrono::microseconds>(time));
+    }
+    if (is_stopped() || best_score >= k_mate_threshold ||
+        depth == limits_.depth || (limits_.time && time > *limits_.time) ||
+        (limits_.nodes && nodes_ >= *limits_.nodes)) {
+      break;
+    }
+  }
+
+  if (best_move.is_null()) {
+    Moves moves;
+    board_.generate_all_legal_moves(moves);
+    assert(moves.size != 0);
+    best_move = moves.data[0];
+  }
+
+  if constexpr (SearchStats::k_enabled) {
+    const auto time{std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::high_resolution_clock::now() - start)};
+    LOG("AI", stats_.to_json(nodes_, time));
+  }
+  return best_move;
+}
+
+std::optional<Move> AI::solve_mate(
+    std::chrono::high_resolution_clock::time_point start) {
+  if (!mate_solver_) {
+    mate_solver_ = std::make_unique<MateSolver>();
+  }
+  std::optional<std::chrono::milliseconds> time;
+  if (limits_.time) {
+    const auto elapsed{std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start)};
+    time = std::max(*limits_.time - elapsed, 0ms) / k_mate_solver_share;
+  }
+  std::optional<uint64_t> nodes;
+  if (limits_.nodes) {
+    nodes = (*limits_.nodes - std::min(nodes_, *limits_.nodes)) /
+            k_mate_solver_share;
+  }
+  const MateSolver::Solution solution{mate_solver_->solve(
+      board_, {.threads = limits_.mate_threads, .time = time, .nodes = nodes},
+      stop_)};
+  nodes_ += solution.nodes;
+  if (solution.result != MateSolver::Result::Mate || solution.pv.empty()) {
+    return std::nullopt;
+  }
+
+  const auto plies{static_cast<int>(solution.pv.size())};
+  SearchProgress progress{
+      .depth = plies,
+      .score = k_mate_score - plies,
+      .mate = (plies + 1) / 2,
+      .nodes = solution.nodes,
+      .nps = solution.nodes * 1000 /
+             static_cast<uint64_t>(solution.time.count() + 1),
+      .time = solution.time,
+      .pv_size = std::min(plies, SearchProgress::k_max_pv_size)};
+  std::copy_n(solution.pv.begin(), progress.pv_size, progress.pv.begin());
+  progress_.push(progress);
+  return solution.pv[0];
+}
+
+// Draws are left to the search, which plays on for the opponent's mistakes.
+std::optional<Move> AI::probe_tablebase() {
+  const auto start{std::chrono::high_resolution_clock::now()};
+  const auto root{tablebase_->probe(board_)};
+  if (!root || root->wdl == Tablebase::Wdl::Draw) {
+    return std::nullopt;
+  }
+  const auto best{find_tablebase_move(board_)};
+  if (!best) {
+    return std::nullopt;
+  }
+
+  SearchProgress progress{
+      .depth = root->plies,
+      .score = best->second,
+      .mate = root->wdl == Tablebase::Wdl::Win ? (root->plies + 1) / 2
+                                               : -root->plies / 2};
+  Board board{board_};
+  while (progress.pv_size < std::min(root->plies, k_max_ply)) {
+    const auto move{find_tablebase_move(board)};
+    if (!move) {
+      break;
+    }
+    progress.pv[static_cast<size_t>(progress.pv_size++)] = move->first;
+    board.make_move(move->first);
+  }
+  progress.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::high_resolution_clock::now() - start);
+  progress_.push(progress);
+  return best->first;
+}
+
+std::optional<std::pair<PackedMove, int>> AI::find_tablebase_move(
+    Board& board) const {
+  Moves moves;
+  board.generate_all_legal_moves(moves);
+  std::optional<std::pair<PackedMove, int>> best;
+  for (const PackedMove move : moves) {
+    board.make_move(move);
+    const auto result{tablebase_->probe(board)};
+    board.undo();
+    if (!result) {
+      return std::nullopt;
+    }
+    const int score{-get_tablebase_score(*result)};
+    if (!best || score > best->second) {
+      best = {move, score};
+    }
+  }
+  return best;
+}
+
+int AI::aspiration_search(int depth, int previous_score) {
+  if (depth < k_min_aspiration_depth ||
+      glm::abs(previous_score) >= k_mate_threshold) {
+    return search_line(depth, -k_infinity, k_infinity);
+  }
+
+  int delta{k_aspiration_window};
+  int alpha{previous_score - delta};
+  int beta{previous_score + delta};
+  while (true) {
+    const int score{search_line(depth, alpha, beta)};
+    if (is_stopped()) {
+      return score;
+    }
+    if (score <= alpha && alpha > -k_infinity) {
+      alpha = std::max(score - delta, -k_infinity);
+    } else if (score >= beta && beta < k_infinity) {
+      beta = std::min(score + delta, k_infinity);
+    } else {
+      return score;
+    }
+    delta *= 2;
+  }
+}
+
+int AI::search_line(int depth, int alpha, int beta) {
+  best_move_ = {};
+  follow_pv_ = excluded_moves_.size == 0;
+  return search(depth, 0, alpha, beta);
+}
+
+int AI::search(int depth, int ply, int alpha, int beta) {
+  const auto index{static_cast<size_t>(ply)};
+  pv_length_[index] = ply;
+  if (ply > 0 && tablebase_ && !board_.is_in_draw()) {
+    if (const auto result = tablebase_->probe(board_)) {
+      nodes_++;
+      return get_tablebase_score(*result);
+    }
+  }
+  if (depth == 0 || board_.is_in_checkmate() || board_.is_in_draw() ||
+      ply == k_max_ply - 1) {
     return quiesce(alpha, beta);
   }
-  int max{-1000000};
-  Move best_move;
+  nodes_++;
+  if (limits_.nodes && nodes_ >= *limits_.nodes) {
+    stop_.store(true, std::memory_order_relaxed);
+  }
+  if (is_stopped()) {
+    return 0;
+  }
+
+  using Bound = TranspositionTable::Bound;
+  const int original_alpha{alpha};
+  PackedMove table_move{};
+  const auto entry{table_->probe(board_.get_key())};
+  stats_.add_table_probe(entry.has_value());
+  if (entry) {
+    table_move = entry->move;
+    if (ply > 0 && entry->depth >= depth &&
+        (entry->bound == Bound::Exact ||
+         (entry->bound == Bound::Lower && entry->score >= beta) ||
+         (entry->bound == Bound::Upper && entry->score <= alpha))) {
+      return entry->score;
+    }
+  }
+
+  // Along the previous iteration's PV its move goes first, elsewhere the
+  // table move does.
+  PackedMove first_move{table_move};
+  if (follow_pv_ && ply < previous_pv_length_) {
+    first_move = previous_pv_[index];
+  } else {
+    follow_pv_ = false;
+  }
+
+  int max{-k_infinity};
+  PackedMove best_move{};
   Moves all_legal_moves;
   board_.generate_all_legal_moves(all_legal_moves);
   assert(all_legal_moves.size != 0);
-  order_moves(all_legal_moves);
-  for (int i = 0; i < all_legal_moves.size; i++) {
-    const Move& move = all_legal_moves.data[i];
+  order_moves(board_, all_legal_moves, first_move);
+  follow_pv_ = follow_pv_ && all_legal_moves.data[0] == first_move;
+  bool is_first_move{true};
+  for (const PackedMove move : all_legal_moves) {
+    if (ply == 0 && std::find(excluded_moves_.begin(), excluded_moves_.end(),
+                              move) != excluded_moves_.end()) {
+      continue;
+    }
+    pv_length_[index + 1] = ply + 1;
     board_.make_move(move);
-    const int score{-search(depth - 1, -beta, -alpha)};
+    const int score{board_.is_repetition()
+                        ? 0
+                        : -search(depth - 1, ply + 1, -beta, -alpha)};
     board_.undo();
+    follow_pv_ = false;
     if (score > max) {
       max = score;
       best_move = move;
     }
     if (score > alpha) {
       alpha = score;
+      pv_table_[index][index] = move;
+      std::copy(pv_table_[index + 1].begin() + ply + 1,
+                pv_table_[index + 1].begin() + pv_length_[index + 1],
+                pv_table_[index].begin() + ply + 1);
+      pv_length_[index] = pv_length_[index + 1];
     }
     if (alpha >= beta) {
+      stats_.add_beta_cutoff(is_first_move);
       break;
     }
+    is_first_move = false;
+  }
+
+  if (is_stopped() || best_move.is_null()) {
+    return max;
+  }
+
+  // The root result of a multi-PV line skips moves, so it is not stored.
+  if (ply > 0 || excluded_moves_.size == 0) {
+    const Bound bound{max <= original_alpha ? Bound::Upper
+                      : max >= beta         ? Bound::Lower
+                                            : Bound::Exact};
+    stats_.add_table_store(
+        table_->store(board_.get_key(), depth, max, bound, best_move));
+  }
+  if (ply == 0) {
+    best_move_ = best_move;
   }
-  best_move_ = best_move;
   return max;
 }
 
 int AI::quiesce(int alpha, int beta) {
-  int score{evaluate()};
+  nodes_++;
+  stats_.add_quiescence_node();
+  int score{evaluate(board_)};
 
   if (score >= beta) {
     return beta;
@@ -82,9 +371,8 @@ int AI::quiesce(int alpha, int beta) {
 
   Moves all_legal_moves;
   board_.generate_all_legal_moves(all_legal_moves, true);
-  order_moves(all_legal_moves);
-  for (int i = 0; i < all_legal_moves.size; i++) {
-    const Move& move = all_legal_moves.data[i];
+  order_moves(board_, all_legal_moves);
+  for (const PackedMove move : all_legal_moves) {
     board_.make_move(move);
     score = -quiesce(-beta, -alpha);
     board_.undo();
@@ -100,22 +388,22 @@ int AI::quiesce(int alpha, int beta) {
   return alpha;
 }
 
-int AI::evaluate() const {
-  if (board_.is_in_checkmate()) {
-    return -500000;
+int AI::evaluate(const Board& board) {
+  if (board.is_in_checkmate()) {
+    return -k_mate_score;
   }
 
-  if (board_.is_in_draw()) {
+  if (board.is_in_draw()) {
     return 0;
   }
 
   int score{};
   for (int tile = 0; tile < 64; tile++) {
-    if (board_.is_empty(tile)) {
+    if (board.is_empty(tile)) {
       continue;
     }
-    const PieceColor color = board_.get_color(tile);
-    const int side{board_.get_turn() == color ? 1 : -1};
+    const PieceColor color = board.get_color(tile);
+    const int side{board.get_turn() == color ? 1 : -1};
 
 #define CASE_PIECE(type, table)                                            \
   case PieceType::type:                                                    \
@@ -127,7 +415,7 @@ int AI::evaluate() const {
         side;                                                              \
     break;
 
-    switch (board_.get_type(tile)) {
+    switch (board.get_type(tile)) {
       case PieceType::None:
         assert(false);
         break;
@@ -143,23 +431,29 @@ int AI::evaluate() const {
   return score;
 }
 
-void AI::order_moves(Moves& moves) const {
-  const auto& begin{moves.data.begin()};
+void AI::order_moves(const Board& board, Moves& moves,
+                     PackedMove first_move) {
   // clang-format off
-  std::sort(begin, begin + moves.size, [this](const Move& left, const Move& right) {
-    if (!board_.is_empty(left.target) && !board_.is_empty(right.target)) {
-      if (board_.get_type(left.target) != board_.get_type(right.target)) {
-        return get_piece_value(board_.get_type(left.target)) > get_piece_value(board_.get_type(right.target));
+  std::sort(moves.begin(), moves.end(), [&board](PackedMove left, PackedMove right) {
+    const int left_tile_value{get_piece_value(board.get_type(left.get_tile()))};
+    const int right_tile_value{get_piece_value(board.get_type(right.get_tile()))};
+    if (left.is_capture() && right.is_capture()) {
+      const int left_target_value{get_piece_value(board.get_type(left.get_target()))};
+      const int right_target_value{get_piece_value(board.get_type(right.get_target()))};
+      if (left_target_value != right_target_value) {
+        return left_target_value > right_target_value;
       }
-      if (board_.get_type(left.tile) != board_.get_type(right.tile)) {
-        return get_piece_value(board_.get_type(left.tile)) < get_piece_value(board_.get_type(right.tile));
-      }
-    } else if (!board_.is_empty(left.target)) {
-      return true;
-    } else if (!board_.is_empty(right.target)) {
-      return false;
+    } else if (left.is_capture() != right.is_capture()) {
+      return left.is_capture();
     }
-    return get_piece_value(board_.get_type(left.tile)) < get_piece_value(board_.get_type(right.tile));
+    return left_tile_value < right_tile_value;
   });
   // clang-format on
+
+  if (!first_move.is_null()) {
+    if (auto it = std::find(moves.begin(), moves.end(), first_move);
+        it != moves.end()) {
+      std::rotate(moves.begin(), it, it + 1);
+    }
+  }
 }
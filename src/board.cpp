@@ -1,69 +1,109 @@
 #include "board.hpp"
 
+#include <charconv>
+
+namespace {
+template <PieceColor Color>
+struct ColorTraits {
+  static constexpr bool k_is_white{Color == PieceColor::White};
+  static constexpr PieceColor k_enemy{get_opposite_color(Color)};
+  static constexpr uint8_t k_index{get_color_index(Color)};
+
+  static constexpr int k_pawn_push{k_is_white ? 8 : -8};
+  static constexpr int k_pawn_row{k_is_white ? 1 : 6};
+  static constexpr int k_promotion_row{k_is_white ? 7 : 0};
+
+  static constexpr int k_king_tile{k_is_white ? 4 : 60};
+  static constexpr int k_short_rook_tile{k_king_tile + 3};
+  static constexpr int k_long_rook_tile{k_king_tile - 4};
+};
+}  // namespace
+
 Board::Board() { load_fen(); }
 
-void Board::make_move(Move move) {
+void Board::make_move(PackedMove move) {
   this->move(move);
-  const bool has_legal_moves{this->has_legal_moves()};
+  update_status();
+}
+
+void Board::update_status() {
+  const bool has_legal_moves{turn_ == PieceColor::White
+                                 ? this->has_legal_moves<PieceColor::White>()
+                                 : this->has_legal_moves<PieceColor::Black>()};
   is_in_check_ = is_threatened(king_tiles_[get_color_index(turn_)],
                                get_opposite_color(turn_));
   is_in_checkmate_ = is_in_check_ && !has_legal_moves;
-  is_in_draw_ = !is_in_check_ && !has_legal_moves;
+  is_in_draw_ = (!is_in_check_ && !has_legal_moves) ||
+                (!is_in_checkmate_ &&
+                 (halfmove_clock_ >= 100 || count_repetitions(2) == 2));
+}
+
+void Board::play_move(PackedMove move) {
+  make_move(move);
+  records_.push(stack_.back());
+  stack_.pop();
 }
 
 void Board::undo() {
-  if (records_.empty()) {
+  const bool is_search_move{!stack_.empty()};
+  if (!is_search_move && records_.empty()) {
     return;
   }
 
-  const MoveRecord& record{records_.back()};
-  const PieceType moved_type{get_type(record.move.target)};
-  set_tile(record.move.tile, get_tile(record.move.target));
+  const MoveRecord& record{is_search_move ? stack_.back() : records_.back()};
+  const int tile{record.move.get_tile()};
+  const int target{record.move.get_target()};
+  const PieceType moved_type{get_type(target)};
+  set_tile(tile, get_tile(target));
 
-  int captured_tile{record.move.target};
-  if (moved_type == PieceType::Pawn &&
-      record.enpassant_tile == record.move.target) {
-    captured_tile =
-        record.move.target +
-        (get_color(record.move.target) == PieceColor::White ? -8 : 8);
-    set_tile(record.move.target, {});
+  int captured_tile{target};
+  if (moved_type == PieceType::Pawn && record.enpassant_tile == target) {
+    captured_tile = target + (get_color(target) == PieceColor::White ? -8 : 8);
+    set_tile(target, {});
   }
 
   set_tile(captured_tile, record.captured_piece);
 
   if (moved_type == PieceType::King) {
-    if (glm::abs(record.move.target - record.move.tile) == 2) {
-      set_tile(
-          record.move.tile + (record.move.tile < record.move.target ? 3 : -4),
-          make_piece(
-              record.move.target < 8 ? PieceColor::White : PieceColor::Black,
-              PieceType::Rook));
-      set_tile((record.move.tile + record.move.target) / 2, {});
+    if (glm::abs(target - tile) == 2) {
+      set_tile(tile + (tile < target ? 3 : -4),
+               make_piece(target < 8 ? PieceColor::White : PieceColor::Black,
+                          PieceType::Rook));
+      set_tile((tile + target) / 2, {});
     }
-    king_tiles_[get_color_index(get_color(record.move.tile))] =
-        record.move.tile;
+    king_tiles_[get_color_index(get_color(tile))] = tile;
   }
 
-  if (record.promotion != PieceType::None) {
-    set_tile(record.move.tile,
-             make_piece(
-                 record.move.target < 8 ? PieceColor::Black : PieceColor::White,
-                 PieceType::Pawn));
+  if (record.move.is_promotion()) {
+    set_tile(tile,
+             make_piece(target < 8 ? PieceColor::Black : PieceColor::White,
+                        PieceType::Pawn));
   }
 
   turn_ = get_opposite_color(turn_);
+  if (turn_ == PieceColor::Black) {
+    fullmove_number_--;
+  }
   castling_rights_ = record.castling_rights;
   enpassant_tile_ = record.enpassant_tile;
+  halfmove_clock_ = record.halfmove_clock;
+  key_ = record.key;
   is_in_check_ = record.is_in_check_;
   is_in_checkmate_ = record.is_in_checkmate_;
   is_in_draw_ = record.is_in_draw_;
 
-  records_.pop_back();
+  if (is_search_move) {
+    stack_.pop();
+  } else {
+    records_.pop();
+  }
 }
 
 void Board::generate_all_legal_moves(Moves& moves, bool only_captures) {
-  for (int tile = 0; tile < 64; tile++) {
-    generate_legal_moves(moves, tile, only_captures);
+  if (turn_ == PieceColor::White) {
+    generate_all_legal_moves<PieceColor::White>(moves, only_captures);
+  } else {
+    generate_all_legal_moves<PieceColor::Black>(moves, only_captures);
   }
 }
 
@@ -71,23 +111,47 @@ void Board::generate_legal_moves(Moves& moves, int tile, bool only_captures) {
   if (turn_ != get_color(tile)) {
     return;
   }
-  auto check_king = [this] {
-    return is_threatened(
-        king_tiles_[get_color_index(get_opposite_color(turn_))], turn_);
-  };
+  if (turn_ == PieceColor::White) {
+    generate_legal_moves<PieceColor::White>(moves, tile, only_captures);
+  } else {
+    generate_legal_moves<PieceColor::Black>(moves, tile, only_captures);
+  }
+}
+
+uint64_t Board::perft(int depth) {
+  return turn_ == PieceColor::White ? perft<PieceColor::White>(depth)
+                                    : perft<PieceColor::Black>(depth);
+}
+
+template <PieceColor Color>
+void Board::generate_all_legal_moves(Moves& moves, bool only_captures) {
+  for (int tile = 0; tile < 64; tile++) {
+    if (get_color(tile) == Color) {
+      generate_legal_moves<Color>(moves, tile, only_captures);
+    }
+  }
+}
+
+template <PieceColor Color>
+void Board::generate_legal_moves(Moves& moves, int tile, bool only_captures) {
+  using Traits = ColorTraits<Color>;
   int end{moves.size};
-  generate_moves(moves, tile);
+  generate_moves<Color>(moves, tile);
   for (int i = end; i < moves.size; i++) {
-    const bool captured{!is_empty(moves.data[i].target)};
-    move(moves.data[i]);
-    if (!check_king() && (!only_captures || (only_captures && captured))) {
-      moves.data[end++] = moves.data[i];
+    const PackedMove move{moves.data[static_cast<size_t>(i)]};
+    if (only_captures && !move.is_capture()) {
+      continue;
+    }
+    this->move(move);
+    if (!is_threatened<Traits::k_enemy>(king_tiles_[Traits::k_index])) {
+      moves.data[static_cast<size_t>(end++)] = move;
     }
     undo();
   }
   moves.size = end;
 }
 
+template <PieceColor Color>
 uint64_t Board::perft(int depth) {
   uint64_t nodes{};
   if (depth == 0) {
@@ -95,151 +159,391 @@ uint64_t Board::perft(int depth) {
   }
 
   Moves moves;
-  generate_all_legal_moves(moves);
-  for (int i = 0; i < moves.size; i++) {
-    move(moves.data[i]);
-    nodes += perft(depth - 1);
+  generate_all_legal_moves<Color>(moves, false);
+  for (const PackedMove move : moves) {
+    this->move(move);
+    nodes += perft<ColorTraits<Color>::k_enemy>(depth - 1);
     undo();
   }
 
   return nodes;
 }
 
-void Board::load_fen(std::string_view fen) {
+std::optional<FenError> Board::load_fen(std::string_view fen) {
+  const std::optional<FenError> error{set_fen(fen)};
+  if (error) {
+    set_fen(k_initial_fen);
+  }
+  return error;
+}
+
+std::string Board::to_fen() const {
+  std::string fen;
+  fen.reserve(90);
+  for (int row = 7; row >= 0; row--) {
+    int empty_tiles{};
+    for (int column = 0; column < 8; column++) {
+      const int tile{8 * row + column};
+      if (is_empty(tile)) {
+        empty_tiles++;
+        continue;
+      }
+      if (empty_tiles != 0) {
+        fen += static_cast<char>('0' + empty_tiles);
+        empty_tiles = 0;
+      }
+      const char ch{"?kqbnrp"[to_underlying(get_type(tile))]};
+      fen += get_color(tile) == PieceColor::White
+                 ? static_cast<char>(ch - 'a' + 'A')
+                 : ch;
+    }
+    if (empty_tiles != 0) {
+      fen += static_cast<char>('0' + empty_tiles);
+    }
+    if (row != 0) {
+      fen += '/';
+    }
+  }
+
+  fen += turn_ == PieceColor::White ? " w " : " b ";
+
+  auto has_castling_right = [this](size_t index, CastlingRight right) {
+    return (to_underlying(castling_rights_[index]) & to_underlying(right)) != 0;
+  };
+  const size_t castling_offset{fen.size()};
+  if (has_castling_right(1, CastlingRight::Short)) {
+    fen += 'K';
+  }
+  if (has_castling_right(1, CastlingRight::Long)) {
+    fen += 'Q';
+  }
+  if (has_castling_right(0, CastlingRight::Short)) {
+    fen += 'k';
+  }
+  if (has_castling_right(0, CastlingRight::Long)) {
+    fen += 'q';
+  }
+  if (fen.size() == castling_offset) {
+    fen += '-';
+  }
+
+  fen += ' ';
+  if (enpassant_tile_ == -1) {
+    fen += '-';
+  } else {
+    fen += static_cast<char>('a' + get_tile_column(enpassant_tile_));
+    fen += static_cast<char>('1' + get_tile_row(enpassant_tile_));
+  }
+
+  fen += std::format(" {} {}", halfmove_clock_, fullmove_number_);
+  return fen;
+}
+
+bool Board::load_packed(const PackedPosition& position) {
+  auto fail = [this] {
+    load_fen();
+    return false;
+  };
+  clear();
+  if (std::popcount(position.occupancy) > PackedPosition::k_max_pieces ||
+      position.enpassant_tile < -1 || position.enpassant_tile >= 64) {
+    return fail();
+  }
+
+  std::array<bool, 2> has_king{};
+  Bitboard occupancy{position.occupancy};
+  for (size_t i = 0; occupancy != 0; i++) {
+    const int tile{pop_tile(occupancy)};
+    const unsigned code{
+        static_cast<unsigned>(position.pieces[i / 2] >> (4 * (i % 2))) & 15U};
+    const auto type{static_cast<PieceType>(code & 7U)};
+    const PieceColor color{(code & 8U) != 0 ? PieceColor::Black
+                                            : PieceColor::White};
+    if (type == PieceType::None || type > PieceType::Pawn) {
+      return fail();
+    }
+    if (type == PieceType::King) {
+      const uint8_t color_index{get_color_index(color)};
+      if (has_king[color_index]) {
+        return fail();
+      }
+      has_king[color_index] = true;
+      king_tiles_[color_index] = tile;
+    }
+    set_tile(tile, make_piece(color, type));
+  }
+  if (!has_king[0] || !has_king[1]) {
+    return fail();
+  }
+
+  turn_ = (position.state & 1U) != 0 ? PieceColor::Black : PieceColor::White;
+  castling_rights_ = {static_cast<CastlingRight>(position.state >> 1U & 3U),
+                      static_cast<CastlingRight>(position.state >> 3U & 3U)};
+  enpassant_tile_ = position.enpassant_tile;
+  halfmove_clock_ = position.halfmove_clock;
+  fullmove_number_ = position.fullmove_number;
+
+  key_ ^= get_state_key();
+  update_status();
+  return true;
+}
+
+std::optional<PackedPosition> Board::to_packed() const {
+  PackedPosition position;
+  size_t i{};
+  for (int tile = 0; tile < 64; tile++) {
+    if (is_empty(tile)) {
+      continue;
+    }
+    if (i == static_cast<size_t>(PackedPosition::k_max_pieces)) {
+      return std::nullopt;
+    }
+    position.occupancy |= make_bitboard(tile);
+    const unsigned code{to_underlying(get_type(tile)) |
+                        (get_color(tile) == PieceColor::Black ? 8U : 0U)};
+    position.pieces[i / 2] |= static_cast<uint8_t>(code << (4 * (i % 2)));
+    i++;
+  }
+
+  position.state = static_cast<uint8_t>(
+      (turn_ == PieceColor::Black ? 1U : 0U) |
+      static_cast<unsigned>(to_underlying(castling_rights_[0])) << 1U |
+      static_cast<unsigned>(to_underlying(castling_rights_[1])) << 3U);
+  position.enpassant_tile = static_cast<int8_t>(enpassant_tile_);
+  position.halfmove_clock =
+      static_cast<uint8_t>(std::min(halfmove_clock_, 255));
+  position.fullmove_number =
+      static_cast<uint16_t>(std::min(fullmove_number_, 65535));
+  return position;
+}
+
+void Board::clear() {
   turn_ = {};
   castling_rights_ = {};
   king_tiles_ = {};
   enpassant_tile_ = -1;
+  halfmove_clock_ = 0;
+  fullmove_number_ = 1;
+  key_ = 0;
   tiles_ = {};
+  bitboards_ = {};
   is_in_check_ = false;
   is_in_checkmate_ = false;
   is_in_draw_ = false;
+  stack_.clear();
   records_ = {};
+}
 
-  std::array<std::string_view, 6> parts{};
-  for (int i = 0, begin = 0, end = 0; i < 6; i++) {
-    begin = end;
-    end = static_cast<int>(fen.find_first_of(' ', begin + 1));
-    parts[i] = fen.substr(begin, end - begin);
-    end++;  // Skip whitespace
-  }
+std::optional<FenError> Board::set_fen(std::string_view fen) {
+  clear();
+
+  size_t offset{};
+  size_t field_offset{};
+  // Returns the next whitespace separated field, empty after the last one.
+  auto next_field = [&fen, &offset, &field_offset] {
+    constexpr std::string_view k_whitespace{" \t\r\n"};
+    field_offset = std::min(fen.find_first_not_of(k_whitespace, offset),
+                            fen.size());
+    offset = std::min(fen.find_first_of(k_whitespace, field_offset),
+                      fen.size());
+    return fen.substr(field_offset, offset - field_offset);
+  };
 
-  for (int i = 0, tile = 0; i < parts[0].length(); i++) {
-    const char ch{parts[0][i]};
+  const std::string_view placement{next_field()};
+  std::array<bool, 2> has_king{};
+  std::array<int, 2> piece_counts{};
+  int row{7};
+  int column{};
+  for (size_t i = 0; i < placement.size(); i++) {
+    const char ch{placement[i]};
+    const size_t ch_offset{field_offset + i};
 
     if (ch == '/') {
+      if (column != 8 || row == 0) {
+        return FenError{ch_offset, "Rank does not have 8 tiles"};
+      }
+      row--;
+      column = 0;
       continue;
     }
 
-    if (ch >= '0' && ch <= '8') {
-      tile += ch - '0';
+    if (ch >= '1' && ch <= '8') {
+      column += ch - '0';
+      if (column > 8) {
+        return FenError{ch_offset, "Rank has more than 8 tiles"};
+      }
       continue;
     }
 
-    auto color{PieceColor::Black};
-    if (ch >= 'A' && ch < 'Z') {
-      color = PieceColor::White;
-    }
-
-    const int tile_rot{8 * (7 - get_tile_row(tile)) + get_tile_column(tile)};
-
+    const bool is_white{ch >= 'A' && ch <= 'Z'};
+    const char lower{is_white ? static_cast<char>(ch - 'A' + 'a') : ch};
     PieceType type{};
-    switch (ch) {
-      case 'K':
-        king_tiles_[1] = tile_rot;
-        [[fallthrough]];
+    switch (lower) {
       case 'k':
         type = PieceType::King;
-        if (ch == 'K') {
-          break;
-        }
-        king_tiles_[0] = tile_rot;
         break;
-      case 'Q':
       case 'q':
         type = PieceType::Queen;
         break;
-      case 'B':
       case 'b':
         type = PieceType::Bishop;
         break;
-      case 'N':
       case 'n':
         type = PieceType::Knight;
         break;
-      case 'R':
       case 'r':
         type = PieceType::Rook;
         break;
-      case 'P':
       case 'p':
         type = PieceType::Pawn;
         break;
       default:
-        break;
+        return FenError{ch_offset, "Invalid character"};
+    }
+    if (column == 8) {
+      return FenError{ch_offset, "Rank has more than 8 tiles"};
     }
 
-    if (type != PieceType::None) {
-      set_tile(tile_rot, make_piece(color, type));
+    const PieceColor color{is_white ? PieceColor::White : PieceColor::Black};
+    const int tile{8 * row + column};
+    const uint8_t color_index{get_color_index(color)};
+    if (++piece_counts[color_index] > PackedPosition::k_max_pieces / 2) {
+      return FenError{ch_offset, "More than 16 pieces of a color"};
     }
-    tile++;
+    if (type == PieceType::King) {
+      if (has_king[color_index]) {
+        return FenError{ch_offset, "More than one king of a color"};
+      }
+      has_king[color_index] = true;
+      king_tiles_[color_index] = tile;
+    }
+    if (type == PieceType::Pawn && (row == 0 || row == 7)) {
+      return FenError{ch_offset, "Pawn on the first or last rank"};
+    }
+    set_tile(tile, make_piece(color, type));
+    column++;
+  }
+  if (row != 0 || column != 8) {
+    return FenError{field_offset, "Board does not have 8 ranks of 8 tiles"};
+  }
+  if (!has_king[0] || !has_king[1]) {
+    return FenError{field_offset, "Missing king"};
   }
 
-  if (parts[1] == "w") {
+  const std::string_view turn{next_field()};
+  if (turn == "w") {
     turn_ = PieceColor::White;
-  } else if (parts[1] == "b") {
+  } else if (turn == "b") {
     turn_ = PieceColor::Black;
+  } else {
+    return FenError{field_offset, "Side to move is not w or b"};
   }
 
-  auto set_castling_right = [this](int index, CastlingRight right) {
+  const std::string_view castling{next_field()};
+  if (castling.empty()) {
+    return FenError{field_offset, "Missing castling rights"};
+  }
+  for (size_t i = 0; castling != "-" && i < castling.size(); i++) {
+    const char ch{castling[i]};
+    const bool is_white{ch == 'K' || ch == 'Q'};
+    const bool is_short{ch == 'K' || ch == 'k'};
+    if (!is_white && !is_short && ch != 'q') {
+      return FenError{field_offset + i, "Invalid castling right"};
+    }
+    const size_t index{is_white ? 1U : 0U};
+    const int king_tile{is_white ? 4 : 60};
+    const int rook_tile{king_tile + (is_short ? 3 : -4)};
+    const PieceColor color{is_white ? PieceColor::White : PieceColor::Black};
+    const CastlingRight right{is_short ? CastlingRight::Short
+                                       : CastlingRight::Long};
+    if ((to_underlying(castling_rights_[index]) & to_underlying(right)) != 0) {
+      return FenError{field_offset + i, "Repeated castling right"};
+    }
+    if (!is_piece(king_tile, color, PieceType::King) ||
+        !is_piece(rook_tile, color, PieceType::Rook)) {
+      return FenError{field_offset + i,
+                      "Castling right without king and rook on their tiles"};
+    }
     castling_rights_[index] = static_cast<CastlingRight>(
         to_underlying(castling_rights_[index]) | to_underlying(right));
-  };
+  }
 
-  for (const char ch : parts[2]) {
-    switch (ch) {
-      case 'K':
-        set_castling_right(1, CastlingRight::Short);
-        break;
-      case 'k':
-        set_castling_right(0, CastlingRight::Short);
-        break;
-      case 'Q':
-        set_castling_right(1, CastlingRight::Long);
-        break;
-      case 'q':
-        set_castling_right(0, CastlingRight::Long);
-        break;
-      default:
-        break;
+  const std::string_view enpassant{next_field()};
+  if (enpassant.empty()) {
+    return FenError{field_offset, "Missing en passant tile"};
+  }
+  if (enpassant != "-") {
+    const char enpassant_row{turn_ == PieceColor::White ? '6' : '3'};
+    if (enpassant.size() != 2 || enpassant[0] < 'a' || enpassant[0] > 'h' ||
+        enpassant[1] != enpassant_row) {
+      return FenError{field_offset, "Invalid en passant tile"};
+    }
+    enpassant_tile_ = 8 * (enpassant[1] - '1') + (enpassant[0] - 'a');
+    const int pawn_tile{enpassant_tile_ +
+                        (turn_ == PieceColor::White ? -8 : 8)};
+    if (!is_piece(pawn_tile, get_opposite_color(turn_), PieceType::Pawn)) {
+      return FenError{field_offset, "En passant tile without a pawn to take"};
     }
   }
 
-  if (parts[3] != "-") {
-    enpassant_tile_ = 8 * (parts[3][1] - '0' - 1) + (parts[3][0] - 'a');
+  auto parse_number = [](std::string_view field, int& number) {
+    const auto [end, error] =
+        std::from_chars(field.data(), field.data() + field.size(), number);
+    return error == std::errc{} && end == field.data() + field.size();
+  };
+  if (const std::string_view halfmove_clock{next_field()};
+      !halfmove_clock.empty() &&
+      (!parse_number(halfmove_clock, halfmove_clock_) ||
+       halfmove_clock_ < 0)) {
+    return FenError{field_offset, "Invalid halfmove clock"};
   }
+  if (const std::string_view fullmove_number{next_field()};
+      !fullmove_number.empty() &&
+      (!parse_number(fullmove_number, fullmove_number_) ||
+       fullmove_number_ < 1)) {
+    return FenError{field_offset, "Invalid fullmove number"};
+  }
+  if (!next_field().empty()) {
+    return FenError{field_offset, "Unexpected field after the fullmove number"};
+  }
+
+  if (is_threatened(king_tiles_[get_color_index(get_opposite_color(turn_))],
+                    turn_)) {
+    return FenError{0, "Side not to move is in check"};
+  }
+
+  key_ ^= get_state_key();
+  update_status();
+  return std::nullopt;
 }
 
-void Board::move(Move move) {
-  assert(get_color(move.tile) != PieceColor::None &&
-         get_type(move.tile) != PieceType::None);
+void Board::move(PackedMove move) {
+  const int tile{move.get_tile()};
+  const int target{move.get_target()};
+  assert(get_color(tile) != PieceColor::None &&
+         get_type(tile) != PieceType::None);
 
-  const MoveRecord& record{records_.emplace_back(
-      move, move.promotion, get_tile(move.target), castling_rights_,
-      enpassant_tile_, is_in_check_, is_in_checkmate_, is_in_draw_)};
-  set_tile(move.target, get_tile(move.tile));
-  set_tile(move.tile, {});
+  MoveRecord& record{stack_.push(
+      {move, get_tile(target), castling_rights_, enpassant_tile_,
+       halfmove_clock_, key_, is_in_check_, is_in_checkmate_, is_in_draw_})};
+  const bool is_pawn_move{get_type(tile) == PieceType::Pawn};
+  key_ ^= get_state_key();
+  set_tile(target, get_tile(tile));
+  set_tile(tile, {});
 
   turn_ = get_opposite_color(turn_);
+  if (turn_ == PieceColor::White) {
+    fullmove_number_++;
+  }
   enpassant_tile_ = -1;
 
-  auto clear_castling_rights = [this](int tile, PieceColor color) {
+  auto clear_castling_rights = [this](int corner_tile, PieceColor color) {
     auto clear_castling_right = [this](int color_index, CastlingRight right) {
       castling_rights_[color_index] = static_cast<CastlingRight>(
           to_underlying(castling_rights_[color_index]) & ~to_underlying(right));
     };
 
-    switch (tile) {
+    switch (corner_tile) {
       case 0:
         if (color == PieceColor::White) {
           clear_castling_right(1, CastlingRight::Long);
@@ -265,50 +569,132 @@ void Board::move(Move move) {
     }
   };
 
-  const uint8_t color_index{get_color_index(get_color(move.target))};
-  if (castling_rights_[color_index] != CastlingRight::None &&
-      get_piece_type(record.captured_piece) == PieceType::Rook) {
-    clear_castling_rights(move.target, get_piece_color(record.captured_piece));
+  const uint8_t color_index{get_color_index(get_color(target))};
+  if (get_piece_type(record.captured_piece) == PieceType::Rook) {
+    clear_castling_rights(target, get_piece_color(record.captured_piece));
   }
 
-  switch (get_type(move.target)) {
+  switch (get_type(target)) {
     case PieceType::King:
-      if (glm::abs(move.target - move.tile) == 2) {
-        const int rook_tile{move.tile + (move.tile < move.target ? 3 : -4)};
-        set_tile((move.tile + move.target) / 2, get_tile(rook_tile));
+      if (glm::abs(target - tile) == 2) {
+        const int rook_tile{tile + (tile < target ? 3 : -4)};
+        set_tile((tile + target) / 2, get_tile(rook_tile));
         set_tile(rook_tile, {});
       }
       castling_rights_[color_index] = CastlingRight::None;
-      king_tiles_[color_index] = move.target;
+      king_tiles_[color_index] = target;
       break;
     case PieceType::Rook:
       if (castling_rights_[color_index] != CastlingRight::None) {
-        clear_castling_rights(move.tile, get_color(move.target));
+        clear_castling_rights(tile, get_color(target));
       }
       break;
     case PieceType::Pawn:
-      if (glm::abs(move.target - move.tile) == 16) {
-        enpassant_tile_ = (move.tile + move.target) / 2;
-      } else if (move.target == record.enpassant_tile) {
+      if (glm::abs(target - tile) == 16) {
+        enpassant_tile_ = (tile + target) / 2;
+      } else if (target == record.enpassant_tile) {
         const int captured_tile{
-            move.target +
-            (get_color(move.target) == PieceColor::White ? -8 : 8)};
-        records_.back().captured_piece = get_tile(captured_tile);
+            target + (get_color(target) == PieceColor::White ? -8 : 8)};
+        record.captured_piece = get_tile(captured_tile);
         set_tile(captured_tile, {});
-      } else if (move.promotion != PieceType::None) {
-        set_tile(move.target,
-                 make_piece(get_color(move.target), move.promotion));
+      } else if (move.is_promotion()) {
+        set_tile(target, make_piece(get_color(target), move.get_promotion()));
       }
       break;
     default:
       break;
   }
+
+  if (is_pawn_move ||
+      get_piece_type(record.captured_piece) != PieceType::None) {
+    halfmove_clock_ = 0;
+  } else {
+    halfmove_clock_++;
+  }
+
+  key_ ^= get_state_key();
 }
 
+uint64_t Board::get_state_key() const {
+  uint64_t key{k_zobrist_keys.castling_rights[static_cast<size_t>(
+      to_underlying(castling_rights_[0]) |
+      to_underlying(castling_rights_[1]) << 2U)]};
+  if (is_enpassant_possible()) {
+    key ^= k_zobrist_keys.enpassant_columns[static_cast<size_t>(
+        get_tile_column(enpassant_tile_))];
+  }
+  if (turn_ == PieceColor::Black) {
+    key ^= k_zobrist_keys.black_turn;
+  }
+  return key;
+}
+
+bool Board::is_enpassant_possible() const {
+  return enpassant_tile_ != -1 &&
+         (k_pawn_attacks[get_color_index(get_opposite_color(turn_))]
+                        [static_cast<size_t>(enpassant_tile_)] &
+          get_bitboard(turn_, PieceType::Pawn)) != 0;
+}
+
+int Board::count_repetitions(int limit) const {
+  if (halfmove_clock_ < 4) {
+    return 0;
+  }
+
+  int count{};
+  int distance{};
+  // Positions before the last irreversible move can not repeat, and only
+  // every other one has the same side to move.
+  auto is_done = [this, limit, &count, &distance](const MoveRecord& record) {
+    if (++distance > halfmove_clock_) {
+      return true;
+    }
+    if (distance % 2 == 0 && record.key == key_) {
+      count++;
+    }
+    return count == limit;
+  };
+
+  for (int i = stack_.size() - 1; i >= 0; i--) {
+    if (is_done(stack_[i])) {
+      return count;
+    }
+  }
+  for (auto it = records_.rbegin(); it != records_.rend(); ++it) {
+    if (is_done(*it)) {
+      return count;
+    }
+  }
+  return count;
+}
+
+bool Board::is_threatened(int tile, PieceColor attacker_color) const {
+  return attacker_color == PieceColor::White
+             ? is_threatened<PieceColor::White>(tile)
+             : is_threatened<PieceColor::Black>(tile);
+}
+
+bool Board::is_pseudo_legal(Move move) const {
+  return turn_ == PieceColor::White ? is_pseudo_legal<PieceColor::White>(move)
+                                    : is_pseudo_legal<PieceColor::Black>(move);
+}
+
+bool Board::is_legal(Move move) const {
+  return turn_ == PieceColor::White
+             ? is_pseudo_legal<PieceColor::White>(move) &&
+                   is_king_safe_after<PieceColor::White>(move)
+             : is_pseudo_legal<PieceColor::Black>(move) &&
+                   is_king_safe_after<PieceColor::Black>(move);
+}
+
+template <PieceColor Color>
 bool Board::has_legal_moves() {
   Moves moves;
   for (int tile = 0; tile < 64; tile++) {
-    generate_legal_moves(moves, tile);
+    if (get_color(tile) != Color) {
+      continue;
+    }
+    generate_legal_moves<Color>(moves, tile, false);
     if (moves.size != 0) {
       return true;
     }
@@ -316,72 +702,72 @@ bool Board::has_legal_moves() {
   return false;
 }
 
+template <PieceColor Color>
 void Board::generate_moves(Moves& moves, int tile) const {
+  using Traits = ColorTraits<Color>;
+
   const int row{get_tile_row(tile)};
   const int col{get_tile_column(tile)};
 
   const PieceType tile_type{get_type(tile)};
 
-#define CHECK_MOVE_OFFSET(offset, condition)           \
-  if (const int target = tile + (offset); condition) { \
-    add_move(moves, tile, target);                     \
+#define CHECK_SPECIAL_MOVE_OFFSET(offset, flags, condition) \
+  if (const int target = tile + (offset); condition) {      \
+    add_move(target, flags);                                \
   }
 
 #define CHECK_MOVE_DIRECTION(direction, condition)                          \
   for (int target = tile + (direction); condition; target += (direction)) { \
-    add_move(moves, tile, target);                                          \
+    add_move(target);                                                       \
     if (!is_empty(target)) {                                                \
       break;                                                                \
     }                                                                       \
   }
 
-  auto add_move = [this](Moves& moves, int tile, int target) {
-    assert(get_color(tile) != PieceColor::None);
-    if (get_color(tile) != get_color(target)) {
-      moves.data[moves.size++] = {tile, target};
+  auto add_move = [this, &moves, tile](int target,
+                                       uint8_t flags = PackedMove::Quiet) {
+    if (get_color(target) != Color) {
+      moves.add({tile, target,
+                 is_empty(target) ? flags : uint8_t{PackedMove::Capture}});
     }
   };
 
+  auto add_leaper_moves = [this, &moves, tile](Bitboard attacks) {
+    const Bitboard enemies{get_bitboard(Traits::k_enemy)};
+    for (Bitboard targets = attacks & ~get_bitboard(Color); targets != 0;) {
+      const int target{pop_tile(targets)};
+      moves.add({tile, target,
+                 has_tile(enemies, target) ? uint8_t{PackedMove::Capture}
+                                           : uint8_t{PackedMove::Quiet}});
+    }
+  };
+
+  auto has_castling_right = [this](CastlingRight right) {
+    return (to_underlying(castling_rights_[Traits::k_index]) &
+            to_underlying(right)) != 0;
+  };
+
   switch (tile_type) {
     case PieceType::King:
-      CHECK_MOVE_OFFSET(1, col < 7);
-      CHECK_MOVE_OFFSET(7, row < 7 && col > 0);
-      CHECK_MOVE_OFFSET(8, row < 7);
-      CHECK_MOVE_OFFSET(9, row < 7 && col < 7);
-      CHECK_MOVE_OFFSET(-1, col > 0);
-      CHECK_MOVE_OFFSET(-7, row > 0 && col < 7);
-      CHECK_MOVE_OFFSET(-8, row > 0);
-      CHECK_MOVE_OFFSET(-9, row > 0 && col > 0);
-      if (tile == 4 && castling_rights_[1] != CastlingRight::None &&
-          !is_threatened(4, PieceColor::Black)) {
-        CHECK_MOVE_OFFSET(2, is_piece(7, PieceColor::White, PieceType::Rook) &&
-                                 (castling_rights_[1] == CastlingRight::Short ||
-                                  castling_rights_[1] == CastlingRight::Both) &&
-                                 is_empty(5) && is_empty(6) &&
-                                 !is_threatened(5, PieceColor::Black) &&
-                                 !is_threatened(6, PieceColor::Black));
-        CHECK_MOVE_OFFSET(-2,
-                          is_piece(0, PieceColor::White, PieceType::Rook) &&
-                              (castling_rights_[1] == CastlingRight::Long ||
-                               castling_rights_[1] == CastlingRight::Both) &&
-                              is_empty(1) && is_empty(2) && is_empty(3) &&
-                              !is_threatened(2, PieceColor::Black) &&
-                              !is_threatened(3, PieceColor::Black));
-      } else if (tile == 60 && castling_rights_[0] != CastlingRight::None &&
-                 !is_threatened(60, PieceColor::White)) {
-        CHECK_MOVE_OFFSET(2, is_piece(63, PieceColor::Black, PieceType::Rook) &&
-                                 (castling_rights_[0] == CastlingRight::Short ||
-                                  castling_rights_[0] == CastlingRight::Both) &&
-                                 is_empty(61) && is_empty(62) &&
-                                 !is_threatened(61, PieceColor::White) &&
-                                 !is_threatened(62, PieceColor::White));
-        CHECK_MOVE_OFFSET(-2,
-                          is_piece(56, PieceColor::Black, PieceType::Rook) &&
-                              (castling_rights_[0] == CastlingRight::Long ||
-                               castling_rights_[0] == CastlingRight::Both) &&
-                              is_empty(57) && is_empty(58) && is_empty(59) &&
-                              !is_threatened(58, PieceColor::White) &&
-                              !is_threatened(59, PieceColor::White));
+      add_leaper_moves(k_king_attacks[static_cast<size_t>(tile)]);
+      if (tile == Traits::k_king_tile &&
+          castling_rights_[Traits::k_index] != CastlingRight::None &&
+          !is_threatened<Traits::k_enemy>(tile)) {
+        CHECK_SPECIAL_MOVE_OFFSET(
+            2, PackedMove::ShortCastling,
+            is_piece(Traits::k_short_rook_tile, Color, PieceType::Rook) &&
+                has_castling_right(CastlingRight::Short) &&
+                is_empty(tile + 1) && is_empty(tile + 2) &&
+                !is_threatened<Traits::k_enemy>(tile + 1) &&
+                !is_threatened<Traits::k_enemy>(tile + 2));
+        CHECK_SPECIAL_MOVE_OFFSET(
+            -2, PackedMove::LongCastling,
+            is_piece(Traits::k_long_rook_tile, Color, PieceType::Rook) &&
+                has_castling_right(CastlingRight::Long) &&
+                is_empty(tile - 1) && is_empty(tile - 2) &&
+                is_empty(tile - 3) &&
+                !is_threatened<Traits::k_enemy>(tile - 1) &&
+                !is_threatened<Traits::k_enemy>(tile - 2));
       }
       break;
     case PieceType::Queen:
@@ -393,6 +779,7 @@ void Board::generate_moves(Moves& moves, int tile) const {
       if (tile_type == PieceType::Bishop) {
         break;
       }
+      [[fallthrough]];
     case PieceType::Rook:
       CHECK_MOVE_DIRECTION(1, target < tile - col + 8);
       CHECK_MOVE_DIRECTION(8, target < 64);
@@ -400,107 +787,83 @@ void Board::generate_moves(Moves& moves, int tile) const {
       CHECK_MOVE_DIRECTION(-8, target >= 0);
       break;
     case PieceType::Knight:
-      CHECK_MOVE_OFFSET(6, target < 64 && col > 1);
-      CHECK_MOVE_OFFSET(10, target < 64 && col < 6);
-      CHECK_MOVE_OFFSET(15, target < 64 && col > 0);
-      CHECK_MOVE_OFFSET(17, target < 64 && col < 7);
-      CHECK_MOVE_OFFSET(-6, target >= 0 && col < 6);
-      CHECK_MOVE_OFFSET(-10, target >= 0 && col > 1);
-      CHECK_MOVE_OFFSET(-15, target >= 0 && col < 7);
-      CHECK_MOVE_OFFSET(-17, target >= 0 && col > 0);
+      add_leaper_moves(k_knight_attacks[static_cast<size_t>(tile)]);
       break;
     case PieceType::Pawn: {
 #define CHECK_PAWN_MOVE_OFFSET(offset, condition)      \
   if (const int target = tile + (offset); condition) { \
-    add_pawn_move(moves, tile, target);                \
+    add_pawn_move(target);                             \
   }
 
-      auto add_pawn_move = [this](Moves& moves, int tile, int target) {
-        assert(get_color(tile) != PieceColor::None);
-        if (get_color(tile) != get_color(target)) {
-          if (target >= 8 && target < 56) {
-            moves.data[moves.size++] = {tile, target};
-            return;
+      auto add_pawn_move = [this, &moves, tile](int target) {
+        const bool is_capture{!is_empty(target)};
+        if (get_tile_row(target) != Traits::k_promotion_row) {
+          uint8_t flags{PackedMove::Quiet};
+          if (is_capture) {
+            flags = PackedMove::Capture;
+          } else if (target - tile != Traits::k_pawn_push) {
+            flags = PackedMove::EnpassantCapture;
           }
-          moves.data[moves.size++] = {tile, target, PieceType::Queen};
-          moves.data[moves.size++] = {tile, target, PieceType::Rook};
-          moves.data[moves.size++] = {tile, target, PieceType::Bishop};
-          moves.data[moves.size++] = {tile, target, PieceType::Knight};
+          moves.add({tile, target, flags});
+          return;
+        }
+        for (const PieceType type : {PieceType::Queen, PieceType::Rook,
+                                     PieceType::Bishop, PieceType::Knight}) {
+          moves.add({tile, target,
+                     PackedMove::make_promotion_flags(type, is_capture)});
         }
       };
 
-      switch (get_color(tile)) {
-        case PieceColor::Black:
-          CHECK_PAWN_MOVE_OFFSET(-8, is_empty(target));
-          CHECK_MOVE_OFFSET(
-              -16, tile >= 48 && is_empty(tile - 8) && is_empty(target));
-          CHECK_PAWN_MOVE_OFFSET(
-              -7, col < 7 && (get_color(target) == PieceColor::White ||
-                              (target == enpassant_tile_ &&
-                               get_color(target) == PieceColor::None)));
-          CHECK_PAWN_MOVE_OFFSET(
-              -9, col > 0 && (get_color(target) == PieceColor::White ||
-                              (target == enpassant_tile_ &&
-                               get_color(target) == PieceColor::None)));
-          break;
-        case PieceColor::White:
-          CHECK_PAWN_MOVE_OFFSET(8, is_empty(target));
-          CHECK_MOVE_OFFSET(
-              16, tile < 16 && is_empty(tile + 8) && is_empty(target));
-          CHECK_PAWN_MOVE_OFFSET(
-              7, col > 0 && (get_color(target) == PieceColor::Black ||
-                             (target == enpassant_tile_ &&
-                              get_color(target) == PieceColor::None)));
-          CHECK_PAWN_MOVE_OFFSET(
-              9, col < 7 && (get_color(target) == PieceColor::Black ||
-                             (target == enpassant_tile_ &&
-                              get_color(target) == PieceColor::None)));
-          break;
-        default:
-          break;
+      CHECK_PAWN_MOVE_OFFSET(Traits::k_pawn_push, is_empty(target));
+      CHECK_SPECIAL_MOVE_OFFSET(2 * Traits::k_pawn_push,
+                                PackedMove::DoublePawnPush,
+                                row == Traits::k_pawn_row &&
+                                    is_empty(tile + Traits::k_pawn_push) &&
+                                    is_empty(target));
+      Bitboard captures{get_bitboard(Traits::k_enemy)};
+      if (enpassant_tile_ != -1) {
+        captures |= make_bitboard(enpassant_tile_);
+      }
+      captures &= k_pawn_attacks[Traits::k_index][static_cast<size_t>(tile)];
+      while (captures != 0) {
+        add_pawn_move(pop_tile(captures));
       }
-    }
 
 #undef CHECK_PAWN_MOVE_OFFSET
-    break;
+      break;
+    }
     default:
       break;
   }
 
-#undef CHECK_MOVE_OFFSET
+#undef CHECK_SPECIAL_MOVE_OFFSET
 #undef CHECK_MOVE_DIRECTION
 }
 
-bool Board::is_threatened(int tile, PieceColor attacker_color) const {
-  const int row{get_tile_row(tile)};
+template <PieceColor Attacker>
+bool Board::is_threatened(int tile) const {
+  using Traits = ColorTraits<Attacker>;
+
   const int col{get_tile_column(tile)};
 
-#define CHECK_THREAT_KNIGHT(offset, condition)                \
-  if (const int target = tile + (offset);                     \
-      (condition) && get_type(target) == PieceType::Knight && \
-      get_color(target) == attacker_color) {                  \
-    return true;                                              \
+  // Pawns attacking tile stand where a defending pawn on tile would capture.
+  const auto index{static_cast<size_t>(tile)};
+  const Bitboard leapers{
+      (k_knight_attacks[index] & get_bitboard(Attacker, PieceType::Knight)) |
+      (k_king_attacks[index] & get_bitboard(Attacker, PieceType::King)) |
+      (k_pawn_attacks[get_color_index(Traits::k_enemy)][index] &
+       get_bitboard(Attacker, PieceType::Pawn))};
+  if (leapers != 0) {
+    return true;
   }
 
-  CHECK_THREAT_KNIGHT(6, col > 1 && row < 7);
-  CHECK_THREAT_KNIGHT(10, col < 6 && row < 7);
-  CHECK_THREAT_KNIGHT(15, col > 0 && row < 6);
-  CHECK_THREAT_KNIGHT(17, col < 7 && row < 6);
-  CHECK_THREAT_KNIGHT(-6, col < 6 && row > 0);
-  CHECK_THREAT_KNIGHT(-10, col > 1 && row > 0);
-  CHECK_THREAT_KNIGHT(-15, col < 7 && row > 1);
-  CHECK_THREAT_KNIGHT(-17, col > 0 && row > 1);
-
-#undef CHECK_THREAT_KNIGHT
-
 #define CHECK_THREAT_DIRECTION(direction, condition, threat_condition)      \
   for (int target = tile + (direction); condition; target += (direction)) { \
     if (is_empty(target)) {                                                 \
       continue;                                                             \
     }                                                                       \
-    const PieceColor target_color{get_color(target)};                       \
     const PieceType target_type{get_type(target)};                          \
-    if (target_color == attacker_color && (threat_condition)) {             \
+    if (get_color(target) == Attacker && (threat_condition)) {              \
       return true;                                                          \
     }                                                                       \
     break;                                                                  \
@@ -508,46 +871,183 @@ bool Board::is_threatened(int tile, PieceColor attacker_color) const {
 
   CHECK_THREAT_DIRECTION(
       8, target < 64,
-      target_type == PieceType::Queen || target_type == PieceType::Rook ||
-          (target_type == PieceType::King && target == tile + 8));
+      target_type == PieceType::Queen || target_type == PieceType::Rook);
   CHECK_THREAT_DIRECTION(
       -8, target >= 0,
-      target_type == PieceType::Queen || target_type == PieceType::Rook ||
-          (target_type == PieceType::King && target == tile - 8));
+      target_type == PieceType::Queen || target_type == PieceType::Rook);
   CHECK_THREAT_DIRECTION(
       -1, target >= tile - col,
-      target_type == PieceType::Queen || target_type == PieceType::Rook ||
-          (target_type == PieceType::King && target == tile - 1));
+      target_type == PieceType::Queen || target_type == PieceType::Rook);
   CHECK_THREAT_DIRECTION(
       1, target < tile - col + 8,
-      target_type == PieceType::Queen || target_type == PieceType::Rook ||
-          (target_type == PieceType::King && target == tile + 1));
+      target_type == PieceType::Queen || target_type == PieceType::Rook);
   CHECK_THREAT_DIRECTION(
       7, target < 64 && get_tile_column(target) != 7,
-      target_type == PieceType::Queen || target_type == PieceType::Bishop ||
-          (target == tile + 7 && (target_type == PieceType::King ||
-                                  (target_type == PieceType::Pawn &&
-                                   target_color == PieceColor::Black))));
+      target_type == PieceType::Queen || target_type == PieceType::Bishop);
   CHECK_THREAT_DIRECTION(
       9, target < 64 && get_tile_column(target) != 0,
-      target_type == PieceType::Queen || target_type == PieceType::Bishop ||
-          (target == tile + 9 && (target_type == PieceType::King ||
-                                  (target_type == PieceType::Pawn &&
-                                   target_color == PieceColor::Black))));
+      target_type == PieceType::Queen || target_type == PieceType::Bishop);
   CHECK_THREAT_DIRECTION(
       -7, target >= 0 && get_tile_column(target) != 0,
-      target_type == PieceType::Queen || target_type == PieceType::Bishop ||
-          (target == tile - 7 && (target_type == PieceType::King ||
-                                  (target_type == PieceType::Pawn &&
-                                   target_color == PieceColor::White))));
+      target_type == PieceType::Queen || target_type == PieceType::Bishop);
   CHECK_THREAT_DIRECTION(
       -9, target >= 0 && get_tile_column(target) != 7,
-      target_type == PieceType::Queen || target_type == PieceType::Bishop ||
-          (target == tile - 9 && (target_type == PieceType::King ||
-                                  (target_type == PieceType::Pawn &&
-                                   target_color == PieceColor::White))));
+      target_type == PieceType::Queen || target_type == PieceType::Bishop);
 
 #undef CHECK_THREAT_DIRECTION
 
   return false;
 }
+
+template <PieceColor Attacker>
+bool Board::is_threatened(int tile, Bitboard occupancy,
+                          Bitboard attackers) const {
+  using Traits = ColorTraits<Attacker>;
+
+  auto get_attackers = [this, attackers](PieceType type) {
+    return get_bitboard(Attacker, type) & attackers;
+  };
+  const auto index{static_cast<size_t>(tile)};
+  if (((k_knight_attacks[index] & get_attackers(PieceType::Knight)) |
+       (k_king_attacks[index] & get_attackers(PieceType::King)) |
+       (k_pawn_attacks[get_color_index(Traits::k_enemy)][index] &
+        get_attackers(PieceType::Pawn))) != 0) {
+    return true;
+  }
+
+  const Bitboard queens{get_attackers(PieceType::Queen)};
+  const Bitboard straight_sliders{queens | get_attackers(PieceType::Rook)};
+  const Bitboard diagonal_sliders{queens | get_attackers(PieceType::Bishop)};
+  // clang-format off
+  constexpr std::array<std::array<int, 2>, 8> k_directions{{
+      {0, 1}, {1, 0}, {0, -1}, {-1, 0}, {1, 1}, {1, -1}, {-1, -1}, {-1, 1}}};
+  // clang-format on
+  for (const auto& [row_delta, column_delta] : k_directions) {
+    const Bitboard sliders{row_delta == 0 || column_delta == 0
+                               ? straight_sliders
+                               : diagonal_sliders};
+    if (sliders == 0) {
+      continue;
+    }
+    int row{get_tile_row(tile) + row_delta};
+    int column{get_tile_column(tile) + column_delta};
+    for (; 0 <= row && row <= 7 && 0 <= column && column <= 7;
+         row += row_delta, column += column_delta) {
+      const int target{8 * row + column};
+      if (has_tile(occupancy, target)) {
+        if (has_tile(sliders, target)) {
+          return true;
+        }
+        break;
+      }
+    }
+  }
+  return false;
+}
+
+template <PieceColor Color>
+bool Board::is_pseudo_legal(Move move) const {
+  using Traits = ColorTraits<Color>;
+
+  const int tile{move.tile};
+  const int target{move.target};
+  if (!is_valid_tile(tile) || !is_valid_tile(target) || tile == target ||
+      get_color(tile) != Color || get_color(target) == Color) {
+    return false;
+  }
+
+  const PieceType type{get_type(tile)};
+  const bool is_promotion_move{type == PieceType::Pawn &&
+                               get_tile_row(target) == Traits::k_promotion_row};
+  const bool is_promotion_piece{move.promotion == PieceType::Queen ||
+                                move.promotion == PieceType::Rook ||
+                                move.promotion == PieceType::Bishop ||
+                                move.promotion == PieceType::Knight};
+  if (is_promotion_move ? !is_promotion_piece
+                        : move.promotion != PieceType::None) {
+    return false;
+  }
+
+  const int row_delta{get_tile_row(target) - get_tile_row(tile)};
+  const int column_delta{get_tile_column(target) - get_tile_column(tile)};
+  // Tiles strictly between tile and target along a line must be empty.
+  auto is_path_clear = [this, tile, target, row_delta, column_delta] {
+    const int step{8 * glm::sign(row_delta) + glm::sign(column_delta)};
+    for (int between = tile + step; between != target; between += step) {
+      if (!is_empty(between)) {
+        return false;
+      }
+    }
+    return true;
+  };
+  const bool is_straight{row_delta == 0 || column_delta == 0};
+  const bool is_diagonal{glm::abs(row_delta) == glm::abs(column_delta)};
+
+  switch (type) {
+    case PieceType::King: {
+      if (has_tile(k_king_attacks[static_cast<size_t>(tile)], target)) {
+        return true;
+      }
+      if (tile != Traits::k_king_tile || glm::abs(target - tile) != 2 ||
+          is_threatened<Traits::k_enemy>(tile)) {
+        return false;
+      }
+      const bool is_short{target > tile};
+      const auto right{is_short ? CastlingRight::Short : CastlingRight::Long};
+      const int step{is_short ? 1 : -1};
+      return (to_underlying(castling_rights_[Traits::k_index]) &
+              to_underlying(right)) != 0 &&
+             is_piece(is_short ? Traits::k_short_rook_tile
+                               : Traits::k_long_rook_tile,
+                      Color, PieceType::Rook) &&
+             is_empty(tile + step) && is_empty(target) &&
+             (is_short || is_empty(tile - 3)) &&
+             !is_threatened<Traits::k_enemy>(tile + step) &&
+             !is_threatened<Traits::k_enemy>(target);
+    }
+    case PieceType::Queen:
+      return (is_straight || is_diagonal) && is_path_clear();
+    case PieceType::Bishop:
+      return is_diagonal && is_path_clear();
+    case PieceType::Rook:
+      return is_straight && is_path_clear();
+    case PieceType::Knight:
+      return has_tile(k_knight_attacks[static_cast<size_t>(tile)], target);
+    case PieceType::Pawn:
+      if (column_delta == 0) {
+        return is_empty(target) &&
+               (target - tile == Traits::k_pawn_push ||
+                (target - tile == 2 * Traits::k_pawn_push &&
+                 get_tile_row(tile) == Traits::k_pawn_row &&
+                 is_empty(tile + Traits::k_pawn_push)));
+      }
+      return has_tile(
+                 k_pawn_attacks[Traits::k_index][static_cast<size_t>(tile)],
+                 target) &&
+             (get_color(target) == Traits::k_enemy ||
+              target == enpassant_tile_);
+    default:
+      return false;
+  }
+}
+
+template <PieceColor Color>
+bool Board::is_king_safe_after(Move move) const {
+  using Traits = ColorTraits<Color>;
+
+  const Bitboard target{make_bitboard(move.target)};
+  Bitboard occupancy{
+      ((get_bitboard(PieceColor::White) | get_bitboard(PieceColor::Black)) &
+       ~make_bitboard(move.tile)) |
+      target};
+  Bitboard attackers{get_bitboard(Traits::k_enemy) & ~target};
+  const PieceType type{get_type(move.tile)};
+  if (type == PieceType::Pawn && move.target == enpassant_tile_) {
+    const Bitboard captured{make_bitboard(move.target - Traits::k_pawn_push)};
+    occupancy &= ~captured;
+    attackers &= ~captured;
+  }
+  return !is_threatened<Traits::k_enemy>(
+      type == PieceType::King ? move.target : king_tiles_[Traits::k_index],
+      occupancy, attackers);
+}
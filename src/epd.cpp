@@ -0,0 +1,110 @@
+#include "epd.hpp"
+
+namespace {
+constexpr std::string_view k_whitespace{" \t\r\n"};
+// The last position field and the clocks may run into the first semicolon.
+constexpr std::string_view k_field_end{" \t\r\n;"};
+
+std::string_view trim(std::string_view text) {
+  const size_t begin{text.find_first_not_of(k_whitespace)};
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  return text.substr(begin, text.find_last_not_of(k_whitespace) - begin + 1);
+}
+
+std::string_view unquote(std::string_view text) {
+  return text.size() >= 2 && text.front() == '"' && text.back() == '"'
+             ? text.substr(1, text.size() - 2)
+             : text;
+}
+}  // namespace
+
+std::optional<EpdRecord> parse_epd(std::string_view line) {
+  EpdRecord record;
+
+  size_t fen_begin{};
+  size_t offset{};
+  for (int i = 0; i < 4; i++) {
+    const size_t begin{line.find_first_not_of(k_whitespace, offset)};
+    if (begin == std::string_view::npos) {
+      return std::nullopt;
+    }
+    if (i == 0) {
+      fen_begin = begin;
+    }
+    offset = std::min(
+        line.find_first_of(i == 3 ? k_field_end : k_whitespace, begin),
+        line.size());
+  }
+
+  // Two integer fields after the position are the clocks of a FEN line, as
+  // opcodes start with a letter.
+  size_t clocks_end{offset};
+  int clock_count{};
+  for (; clock_count < 2; clock_count++) {
+    const size_t begin{line.find_first_not_of(k_whitespace, clocks_end)};
+    if (begin == std::string_view::npos) {
+      break;
+    }
+    const size_t end{
+        std::min(line.find_first_of(k_field_end, begin), line.size())};
+    const std::string_view field{line.substr(begin, end - begin)};
+    if (field.empty() ||
+        field.find_first_not_of("0123456789") != std::string_view::npos) {
+      break;
+    }
+    clocks_end = end;
+  }
+  if (clock_count == 2) {
+    offset = clocks_end;
+  }
+  record.fen = line.substr(fen_begin, offset - fen_begin);
+
+  // Operations are an opcode and operands ended by a semicolon, which may
+  // appear in quoted operands.
+  while (offset < line.size()) {
+    const size_t begin{offset};
+    bool is_quoted{};
+    for (; offset < line.size() && (is_quoted || line[offset] != ';');
+         offset++) {
+      is_quoted ^= line[offset] == '"';
+    }
+    const std::string_view operation{trim(line.substr(begin, offset - begin))};
+    offset++;  // Skip semicolon
+
+    const size_t opcode_end{
+        std::min(operation.find_first_of(k_whitespace), operation.size())};
+    const std::string_view opcode{operation.substr(0, opcode_end)};
+    const std::string_view operands{trim(operation.substr(opcode_end))};
+    if (opcode == "id") {
+      record.id = unquote(operands);
+    } else if (opcode == "c9") {
+      record.result = unquote(operands);
+    } else if (opcode == "bm") {
+      record.best_moves = operands;
+    } else if (opcode == "am") {
+      record.avoid_moves = operands;
+    }
+  }
+  return record;
+}
+
+std::optional<EpdRecord> EpdReader::next() {
+  const std::string_view text{file_.get_text()};
+  while (offset_ < text.size()) {
+    const size_t end{std::min(text.find('\n', offset_), text.size())};
+    const std::string_view line{text.substr(offset_, end - offset_)};
+    offset_ = end + 1;
+    line_number_++;
+
+    if (trim(line).empty()) {
+      continue;
+    }
+    if (auto record = parse_epd(line)) {
+      return record;
+    }
+    LOGF("EPD", "Skipping malformed line {}", line_number_);
+  }
+  return std::nullopt;
+}
@@ -1,12 +1,12 @@
 #include "game.hpp"
 
-#include <algorithm>
 #include <random>
 
 #define SHADER(filename) "resources/shaders/" filename
 #define MODEL(filename) "resources/models/" filename
 
-Game::Game(GLFWwindow* window) : renderer_{window, camera_} {
+Game::Game(GLFWwindow* window, std::shared_ptr<TranspositionTable> table)
+    : renderer_{window, camera_}, ai_{std::move(table)} {
   glfwSetWindowUserPointer(window, this);
 
   glfwSetMouseButtonCallback(window, mouse_button_callback);
@@ -25,6 +25,7 @@ Game::Game(GLFWwindow* window) : renderer_{window, camera_} {
 
   is_camera_moving_ = false;
   active_move_.is_completed = true;
+  update_legal_targets();
 }
 
 void Game::run() {
@@ -74,12 +75,27 @@ void Game::run() {
 void Game::update() {
   process_camera_movement();
 
-  if (game_over_ || ai_.is_thinking()) {
+  if (game_over_) {
     return;
   }
 
-  if (ai_.has_found_move()) {
-    set_active_move(ai_.get_best_move());
+  if (is_ai_thinking()) {
+    // The last progress is pushed before the move is ready, checking first
+    // drains it with the rest.
+    const bool is_ready{ai_move_.wait_for(0s) == std::future_status::ready};
+    while (const auto progress = ai_.poll_progress()) {
+      std::string pv;
+      for (size_t i = 0; i < static_cast<size_t>(progress->pv_size); i++) {
+        pv += (i == 0 ? "" : " ") + to_string(progress->pv[i]);
+      }
+      LOGF("AI", "Depth: {} Score: {} Nodes: {} NPS: {} Time: {}ms PV: {}",
+           progress->depth, progress->score, progress->nodes, progress->nps,
+           progress->time.count(), pv);
+    }
+    if (!is_ready) {
+      return;
+    }
+    set_active_move(ai_move_.get());
   }
 
   process_active_move();
@@ -111,8 +127,8 @@ void Game::draw_picking_texture() {
     renderer_.draw_model(model_name, calculate_piece_transform(tile));
   }
 
-  for (int i = 0; i < selectable_tiles_.size; i++) {
-    const int target{selectable_tiles_.data[i].target};
+  for (Bitboard targets{get_selectable_tiles()}; targets != 0;) {
+    const int target{pop_tile(targets)};
     renderer_.set_shader_uniform("color", target);
     renderer_.draw_model("tile", calculate_tile_transform(target));
   }
@@ -208,8 +224,8 @@ void Game::draw_selectable_tiles() {
     hover = pixel_;
   }
 
-  for (int i = 0; i < selectable_tiles_.size; i++) {
-    const int target{selectable_tiles_.data[i].target};
+  for (Bitboard targets{get_selectable_tiles()}; targets != 0;) {
+    const int target{pop_tile(targets)};
     if (!board_.is_empty(target)) {
       continue;
     }
@@ -252,12 +268,14 @@ void Game::process_camera_movement() {
   }
 }
 
-bool Game::is_selectable_tile(int tile) const {
-  const auto begin{selectable_tiles_.data.begin()};
-  const auto end{begin + selectable_tiles_.size};
-  return std::find_if(begin, end, [tile](const Move& move) {
-           return move.target == tile;
-         }) != end;
+void Game::update_legal_targets() {
+  legal_targets_ = {};
+  Moves moves;
+  board_.generate_all_legal_moves(moves);
+  for (const PackedMove move : moves) {
+    legal_targets_[static_cast<size_t>(move.get_tile())] |=
+        make_bitboard(move.get_target());
+  }
 }
 
 void Game::process_active_move() {
@@ -281,7 +299,9 @@ void Game::process_active_move() {
         return;
       }
 
-      ai_.think(board_);
+      if (is_ai_ready()) {
+        ai_move_ = ai_.think(board_);
+      }
     }
     return;
   }
@@ -299,8 +319,10 @@ void Game::process_active_move() {
           (active_move_.target < 8 || active_move_.target > 55)) {
         promotion = PieceType::Queen;
       }
-      board_.make_move({active_move_.tile, active_move_.target, promotion});
+      board_.play_move(
+          Move{active_move_.tile, active_move_.target, promotion});
     }
+    update_legal_targets();
     active_move_.angle = 0.0F;
     active_move_.is_completed = true;
     if (!is_controlling_camera() && !is_ai_turn()) {
@@ -337,7 +359,28 @@ void Game::set_active_move(const Move& move, bool is_undo) {
   disable_cursor();
 }
 
+void Game::cancel_ai_move() {
+  if (!is_ai_thinking()) {
+    return;
+  }
+  ai_.stop();
+  cancelled_ai_move_ = std::move(ai_move_);
+}
+
+bool Game::is_ai_ready() {
+  if (cancelled_ai_move_.valid()) {
+    if (cancelled_ai_move_.wait_for(0s) != std::future_status::ready) {
+      return false;
+    }
+    (void)cancelled_ai_move_.get();
+    while (ai_.poll_progress()) {
+    }
+  }
+  return true;
+}
+
 void Game::undo() {
+  cancel_ai_move();
   if (const auto& records = board_.get_records(); !records.empty()) {
     set_active_move(records.back().move, true);
     game_over_ = false;
@@ -390,20 +433,19 @@ void Game::mouse_button_callback(GLFWwindow* window, int button, int action,
         game->set_active_move({game->selected_tile_, tile});
       } else if (get_piece_type(piece) != PieceType::None) {
         game->clear_selections();
-        if (game->board_.get_records().empty() && !game->ai_.is_thinking()) {
+        if (game->board_.get_records().empty() && !game->is_ai_thinking() &&
+            game->is_ai_ready()) {
           game->ai_color_ = get_opposite_color(game->board_.get_color(tile));
           if (game->ai_color_ == PieceColor::White) {
-            game->ai_.think(game->board_);
+            game->ai_move_ = game->ai_.think(game->board_);
             game->disable_cursor();
           }
           game->set_camera_target_position(
               game->get_ai_camera_target_position());
         }
-        if (!game->is_ai_turn()) {
-          game->board_.generate_legal_moves(game->selectable_tiles_, tile);
-          if (game->selectable_tiles_.size != 0) {
-            game->selected_tile_ = tile;
-          }
+        if (!game->is_ai_turn() &&
+            game->legal_targets_[static_cast<size_t>(tile)] != 0) {
+          game->selected_tile_ = tile;
         }
       }
     } else {
@@ -476,7 +518,9 @@ void Game::key_callback(GLFWwindow* window, int key, int /*scancode*/,
   if (key == GLFW_KEY_U && action == GLFW_PRESS) {
     game->undo();
   } else if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+    game->cancel_ai_move();
     game->board_.load_fen();
+    game->update_legal_targets();
     game->ai_color_ = PieceColor::None;
     game->game_over_ = false;
   }
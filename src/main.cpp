@@ -1,3 +1,5 @@
+#include <iostream>
+
 #include "game.hpp"
 
 #define GLFW_INCLUDE_NONE
@@ -12,14 +14,33 @@
 GLFWwindow* glfw_init();
 void glfw_destroy();
 
-int main() {
+// Size of a shared hash this process creates.
+constexpr size_t k_shared_hash_mb{64};
+
+// With --shared-hash NAME the AI uses the transposition table in the named
+// shared memory, together with the tools given the same name.
+int main(int argc, char* argv[]) {
+  const bool is_shared{argc == 3 &&
+                       std::string_view{argv[1]} == "--shared-hash"};
+  if (argc != 1 && !is_shared) {
+    std::cerr << "usage: chess-3d [--shared-hash NAME]\n";
+    return 1;
+  }
+  const auto table{is_shared ? std::make_shared<TranspositionTable>(
+                                   argv[2], k_shared_hash_mb)
+                             : std::make_shared<TranspositionTable>()};
+  if (is_shared && !table->is_shared()) {
+    std::cerr << std::format("Failed to open shared hash {}\n", argv[2]);
+    return 1;
+  }
+
   GLFWwindow* window{glfw_init()};
   if (window == nullptr) {
     return 1;
   }
 
   {
-    Game game{window};
+    Game game{window, table};
     game.run();
   }
 
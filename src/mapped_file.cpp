@@ -0,0 +1,165 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    close();
+    std::swap(is_open_, other.is_open_);
+    std::swap(mode_, other.mode_);
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(file_, other.file_);
+#ifdef _WIN32
+    std::swap(mapping_, other.mapping_);
+#endif
+  }
+  return *this;
+}
+
+bool MappedFile::resize(size_t size) {
+  assert(is_open_ && mode_ == Mode::ReadWrite);
+  unmap();
+#ifdef _WIN32
+  LARGE_INTEGER distance{};
+  distance.QuadPart = static_cast<LONGLONG>(size);
+  if (SetFilePointerEx(file_, distance, nullptr, FILE_BEGIN) == 0 ||
+      SetEndOfFile(file_) == 0) {
+    close();
+    return false;
+  }
+#else
+  if (ftruncate(file_, static_cast<off_t>(size)) == -1) {
+    close();
+    return false;
+  }
+#endif
+  size_ = size;
+  if (!map()) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::close() {
+  unmap();
+#ifdef _WIN32
+  if (file_ != nullptr) {
+    CloseHandle(file_);
+  }
+  file_ = nullptr;
+#else
+  if (file_ != -1) {
+    ::close(file_);
+  }
+  file_ = -1;
+#endif
+  is_open_ = false;
+  size_ = 0;
+}
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::filesystem::path& path, Mode mode)
+    : mode_{mode} {
+  const bool is_writable{mode == Mode::ReadWrite};
+  file_ = CreateFileW(
+      path.c_str(), is_writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+      FILE_SHARE_READ, nullptr, is_writable ? OPEN_ALWAYS : OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    file_ = nullptr;
+    return;
+  }
+  LARGE_INTEGER size{};
+  if (GetFileSizeEx(file_, &size) == 0) {
+    close();
+    return;
+  }
+  size_ = static_cast<size_t>(size.QuadPart);
+  if (!map()) {
+    close();
+    return;
+  }
+  is_open_ = true;
+}
+
+bool MappedFile::map() {
+  if (size_ == 0) {
+    return true;
+  }
+  const bool is_writable{mode_ == Mode::ReadWrite};
+  mapping_ = CreateFileMappingW(file_, nullptr,
+                                is_writable ? PAGE_READWRITE : PAGE_READONLY,
+                                0, 0, nullptr);
+  if (mapping_ == nullptr) {
+    return false;
+  }
+  data_ = static_cast<std::byte*>(MapViewOfFile(
+      mapping_, is_writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+  return data_ != nullptr;
+}
+
+void MappedFile::unmap() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_ != nullptr) {
+    CloseHandle(mapping_);
+  }
+  data_ = nullptr;
+  mapping_ = nullptr;
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path& path, Mode mode)
+    : mode_{mode} {
+  file_ = mode == Mode::ReadWrite ? open(path.c_str(), O_RDWR | O_CREAT, 0644)
+                                  : open(path.c_str(), O_RDONLY);
+  if (file_ == -1) {
+    return;
+  }
+  struct stat status {};
+  if (fstat(file_, &status) == -1) {
+    close();
+    return;
+  }
+  size_ = static_cast<size_t>(status.st_size);
+  if (!map()) {
+    close();
+    return;
+  }
+  is_open_ = true;
+}
+
+bool MappedFile::map() {
+  if (size_ == 0) {
+    return true;
+  }
+  const bool is_writable{mode_ == Mode::ReadWrite};
+  void* data{mmap(nullptr, size_,
+                  is_writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                  is_writable ? MAP_SHARED : MAP_PRIVATE, file_, 0)};
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  madvise(data, size_, MADV_SEQUENTIAL);
+  data_ = static_cast<std::byte*>(data);
+  return true;
+}
+
+void MappedFile::unmap() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+  data_ = nullptr;
+}
+#endif
@@ -0,0 +1,382 @@
+#include "mate_solver.hpp"
+
+#include <bit>
+#include <thread>
+
+namespace {
+// Leaves room in the board's move stack.
+constexpr int k_max_plies{200};
+// Nodes a worker searches between looking at the limits.
+constexpr uint64_t k_check_interval{1024};
+// Collection starts at this fill of the table and keeps about half of it.
+constexpr size_t k_collection_percent{75};
+
+// The two smallest values of a node's children.
+template <typename Child>
+struct Ranking {
+  uint64_t best_value{std::numeric_limits<uint64_t>::max()};
+  uint64_t second_value{std::numeric_limits<uint64_t>::max()};
+  Child* best{};
+
+  void add(uint64_t value, Child& child) {
+    if (value < best_value) {
+      second_value = best_value;
+      best_value = value;
+      best = &child;
+    } else if (value < second_value) {
+      second_value = value;
+    }
+  }
+
+  [[nodiscard]] uint32_t get_narrow_threshold(uint32_t threshold) const {
+    return static_cast<uint32_t>(std::min<uint64_t>(
+        threshold, second_value + second_value / 4 + 1));
+  }
+};
+}  // namespace
+
+struct MateSolver::Child {
+  PackedMove move;
+  uint64_t key{};
+  // Mates, draws and repetitions, never looked up in the table.
+  bool is_final{};
+  // The initial estimate, after searching the child its last result.
+  Node node;
+};
+
+struct MateSolver::Worker {
+  Board board;
+  uint64_t nodes{};
+};
+
+MateSolver::MateSolver(size_t size_mb)
+    : entries_(std::max(std::bit_floor(size_mb * 1024 * 1024 / sizeof(Entry)),
+                        k_cluster_size)) {}
+
+MateSolver::Solution MateSolver::solve(const Board& board,
+                                       const Limits& limits,
+                                       const std::atomic<bool>& stop) {
+  assert(limits.threads >= 1);
+  attacker_ = board.get_turn();
+  limits_ = limits;
+  start_ = std::chrono::high_resolution_clock::now();
+  stop_ = &stop;
+  is_stopped_ = false;
+  nodes_ = 0;
+
+  Solution solution;
+  if (board.is_in_checkmate() || board.is_in_draw()) {
+    solution.result = Result::NoMate;
+    return solution;
+  }
+
+  std::vector<Worker> workers(limits.threads, Worker{board});
+  std::vector<Node> roots(limits.threads);
+  {
+    std::vector<std::jthread> threads;
+    for (unsigned i = 0; i < limits.threads; i++) {
+      threads.emplace_back([this, &workers, &roots, i] {
+        roots[i] = search(workers[i], 0, k_infinity, k_infinity);
+        // The first worker to finish the proof stops the others.
+        is_stopped_ = true;
+      });
+    }
+  }
+
+  for (const Worker& worker : workers) {
+    solution.nodes += worker.nodes;
+  }
+  solution.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::high_resolution_clock::now() - start_);
+  for (const Node& root : roots) {
+    if (root.proof == 0) {
+      solution.result = Result::Mate;
+      solution.pv = find_pv(board);
+    } else if (root.disproof == 0) {
+      solution.result = Result::NoMate;
+    }
+  }
+  return solution;
+}
+
+void MateSolver::clear() {
+  std::fill(entries_.begin(), entries_.end(), Entry{});
+  size_ = 0;
+}
+
+std::optional<MateSolver::Entry> MateSolver::probe(uint64_t key) {
+  const size_t cluster{get_cluster(key)};
+  const std::scoped_lock lock{get_lock(cluster)};
+  for (size_t i = cluster; i < cluster + k_cluster_size; i++) {
+    if (entries_[i].key == key && !entries_[i].is_empty()) {
+      return entries_[i];
+    }
+  }
+  return std::nullopt;
+}
+
+void MateSolver::begin_search(uint64_t key, const Node& node) {
+  bool is_added{};
+  {
+    const std::scoped_lock lock{get_lock(get_cluster(key))};
+    find_or_add(key, node, is_added).searchers++;
+  }
+  if (is_added && ++size_ > entries_.size() * k_collection_percent / 100) {
+    collect_garbage();
+  }
+}
+
+void MateSolver::end_search(uint64_t key, const Node& node, uint64_t work,
+                            bool is_started) {
+  bool is_added{};
+  {
+    const std::scoped_lock lock{get_lock(get_cluster(key))};
+    Entry& entry{find_or_add(key, node, is_added)};
+    // Proofs hold on every path, so a result a repetition on this one
+    // changed does not overwrite one. Keeping the first proof also keeps the
+    // distances along the proof decreasing.
+    if (entry.node.proof != 0) {
+      entry.node = node;
+    }
+    // A replaced entry lost its count.
+    if (is_started && entry.searchers != 0) {
+      entry.searchers--;
+    }
+    entry.work = static_cast<uint32_t>(std::min<uint64_t>(
+        uint64_t{entry.work} + work, std::numeric_limits<uint32_t>::max()));
+  }
+  if (is_added && ++size_ > entries_.size() * k_collection_percent / 100) {
+    collect_garbage();
+  }
+}
+
+MateSolver::Entry& MateSolver::find_or_add(uint64_t key, const Node& node,
+                                           bool& is_added) {
+  const size_t cluster{get_cluster(key)};
+  Entry* replaced{&entries_[cluster]};
+  for (size_t i = cluster; i < cluster + k_cluster_size; i++) {
+    Entry& entry{entries_[i]};
+    if (entry.key == key && !entry.is_empty()) {
+      return entry;
+    }
+    // Empty slots first, then the least work, proofs last.
+    if (entry.is_empty() ||
+        (!replaced->is_empty() &&
+         std::pair{entry.node.proof == 0, entry.work} <
+             std::pair{replaced->node.proof == 0, replaced->work})) {
+      replaced = &entry;
+    }
+  }
+  is_added = replaced->is_empty();
+  *replaced = {.key = key, .node = node, .searchers = 0, .work = 0};
+  return *replaced;
+}
+
+void MateSolver::collect_garbage() {
+  const std::unique_lock collecting{garbage_mutex_, std::try_to_lock};
+  if (!collecting.owns_lock()) {
+    return;
+  }
+  std::vector<std::unique_lock<std::mutex>> locks;
+  for (std::mutex& lock : locks_) {
+    locks.emplace_back(lock);
+  }
+  if (size_ <= entries_.size() * k_collection_percent / 100) {
+    return;
+  }
+
+  // Removes the unproven entries whose work is in the lowest powers of two
+  // that together hold half of the entries.
+  std::array<size_t, 33> counts{};
+  for (const Entry& entry : entries_) {
+    if (!entry.is_empty()) {
+      counts[static_cast<size_t>(std::bit_width(entry.work))]++;
+    }
+  }
+  size_t threshold{};
+  for (size_t total = counts[0];
+       total < size_ / 2 && threshold + 1 < counts.size();
+       total += counts[threshold]) {
+    threshold++;
+  }
+
+  size_t removed{};
+  for (Entry& entry : entries_) {
+    if (!entry.is_empty() && entry.node.proof != 0 && entry.searchers == 0 &&
+        static_cast<size_t>(std::bit_width(entry.work)) <= threshold) {
+      entry = {};
+      removed++;
+    }
+  }
+  size_ -= removed;
+  LOGF("MateSolver", "Collected {} of {} entries", removed, size_ + removed);
+}
+
+MateSolver::Node MateSolver::search(Worker& worker, int ply,
+                                    uint32_t proof_threshold,
+                                    uint32_t disproof_threshold) {
+  count_node(worker);
+  const uint64_t start_nodes{worker.nodes};
+  const bool is_attacker{worker.board.get_turn() == attacker_};
+  std::vector<Child> children{expand(worker, ply)};
+  assert(!children.empty());
+
+  // The side to move's own number is the one it minimizes over its children,
+  // the other one it sums.
+  auto get_own = [is_attacker](const Node& child) {
+    return is_attacker ? child.proof : child.disproof;
+  };
+  auto get_other = [is_attacker](const Node& child) {
+    return is_attacker ? child.disproof : child.proof;
+  };
+
+  const uint64_t key{worker.board.get_key()};
+  Node node;
+  bool is_started{};
+  while (true) {
+    // The attacker needs one proven move, the defender to have all of them
+    // proven. The shared ranking counts children other workers are in as
+    // harder, which spreads the workers out.
+    uint64_t sum{};
+    uint16_t plies{is_attacker ? std::numeric_limits<uint16_t>::max()
+                               : uint16_t{0}};
+    Ranking<Child> ranking;
+    Ranking<Child> shared_ranking;
+    for (Child& child : children) {
+      uint16_t searchers{};
+      if (!child.is_final) {
+        if (const auto entry = probe(child.key)) {
+          child.node = entry->node;
+          searchers = entry->searchers;
+        }
+      }
+      const uint32_t own{get_own(child.node)};
+      sum += get_other(child.node);
+      if (child.node.proof == 0) {
+        plies = is_attacker ? std::min(plies, child.node.plies)
+                            : std::max(plies, child.node.plies);
+      }
+      ranking.add(own, child);
+      shared_ranking.add(uint64_t{own} * (searchers + 1U) + searchers, child);
+    }
+    const auto min{static_cast<uint32_t>(ranking.best_value)};
+    // Sums grow fast where transpositions count the same nodes many times,
+    // only a solved child makes them infinite.
+    const auto other_sum{min == 0 ? k_infinity
+                                  : static_cast<uint32_t>(std::min<uint64_t>(
+                                        sum, k_infinity - 1))};
+    node = is_attacker ? Node{min, other_sum, 0} : Node{other_sum, min, 0};
+    if (node.proof == 0) {
+      node.plies = static_cast<uint16_t>(plies + 1);
+    }
+
+    if (node.proof >= proof_threshold ||
+        node.disproof >= disproof_threshold || is_stopped()) {
+      break;
+    }
+    if (!is_started) {
+      begin_search(key, node);
+      is_started = true;
+    }
+
+    // Searches the best child until it gets worse than the second best, by
+    // a quarter to keep from switching back and forth, or until it uses up
+    // the part of the threshold the other children leave. The shared ranking
+    // is followed while its best child is still below the threshold.
+    const uint32_t own_threshold{
+        get_own({proof_threshold, disproof_threshold})};
+    const Ranking<Child>& chosen{
+        get_own(shared_ranking.best->node) <
+                shared_ranking.get_narrow_threshold(own_threshold)
+            ? shared_ranking
+            : ranking};
+    Child& best{*chosen.best};
+    const uint32_t narrow{chosen.get_narrow_threshold(own_threshold)};
+    const auto wide{static_cast<uint32_t>(std::min<uint64_t>(
+        uint64_t{get_other({proof_threshold, disproof_threshold})} -
+            other_sum + get_other(best.node),
+        k_infinity))};
+    worker.board.make_move(best.move);
+    best.node = is_attacker ? search(worker, ply + 1, narrow, wide)
+                            : search(worker, ply + 1, wide, narrow);
+    worker.board.undo();
+  }
+
+  end_search(key, node, worker.nodes - start_nodes, is_started);
+  return node;
+}
+
+std::vector<MateSolver::Child> MateSolver::expand(Worker& worker, int ply) {
+  Board& board{worker.board};
+  Moves moves;
+  board.generate_all_legal_moves(moves);
+  std::vector<Child> children;
+  children.reserve(static_cast<size_t>(moves.size));
+  for (const PackedMove move : moves) {
+    Child& child{children.emplace_back(move)};
+    board.make_move(move);
+    child.key = board.get_key();
+    const bool is_attacker{board.get_turn() == attacker_};
+    if (board.is_in_checkmate() && !is_attacker) {
+      child.is_final = true;
+      child.node = {0, k_infinity, 0};
+    } else if (board.is_in_checkmate() || board.is_in_draw() ||
+               board.is_repetition() || ply + 1 == k_max_plies) {
+      child.is_final = true;
+      child.node = {k_infinity, 0, 0};
+    } else {
+      // The fewer replies, the closer the side to move is to losing.
+      Moves replies;
+      board.generate_all_legal_moves(replies);
+      const auto count{static_cast<uint32_t>(replies.size)};
+      child.node = is_attacker ? Node{1, count, 0} : Node{count, 1, 0};
+    }
+    board.undo();
+  }
+  return children;
+}
+
+void MateSolver::count_node(Worker& worker) {
+  if (++worker.nodes % k_check_interval != 0) {
+    return;
+  }
+  const uint64_t nodes{nodes_ += k_check_interval};
+  if ((limits_.nodes && nodes >= *limits_.nodes) ||
+      (limits_.time &&
+       std::chrono::high_resolution_clock::now() - start_ > *limits_.time)) {
+    is_stopped_ = true;
+  }
+}
+
+std::vector<PackedMove> MateSolver::find_pv(Board board) {
+  std::vector<PackedMove> pv;
+  while (!board.is_in_checkmate() &&
+         pv.size() < static_cast<size_t>(k_max_plies)) {
+    const bool is_attacker{board.get_turn() == attacker_};
+    Moves moves;
+    board.generate_all_legal_moves(moves);
+    std::optional<std::pair<uint16_t, PackedMove>> best;
+    for (const PackedMove move : moves) {
+      board.make_move(move);
+      std::optional<uint16_t> plies;
+      if (board.is_in_checkmate()) {
+        plies = 0;
+      } else if (const auto entry = probe(board.get_key());
+                 entry && entry->node.proof == 0 && !board.is_repetition()) {
+        plies = entry->node.plies;
+      }
+      board.undo();
+      if (plies && (!best || (is_attacker ? *plies < best->first
+                                          : *plies > best->first))) {
+        best = {*plies, move};
+      }
+    }
+    // Lost from the table since.
+    if (!best) {
+      break;
+    }
+    pv.push_back(best->second);
+    board.make_move(best->second);
+  }
+  return pv;
+}
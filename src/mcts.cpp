@@ -0,0 +1,415 @@
+#include "mcts.hpp"
+
+#include <cmath>
+
+namespace {
+constexpr size_t k_max_path{200};
+static_assert(k_max_path < MctsAI::k_max_plies);
+// Bounds the quiescence below k_max_plies, past this it stands pat.
+constexpr int k_max_quiescence_plies{16};
+// Turns centipawns into an expected result from -1 to 1 and back, with the
+// same scale as the win probability of the tuner.
+constexpr double k_value_scale{2.302585092994046 / 800.0};
+
+double to_value(int score) { return std::tanh(score * k_value_scale); }
+
+int to_score(double value) {
+  return static_cast<int>(std::atanh(std::clamp(value, -0.999, 0.999)) /
+                          k_value_scale);
+}
+
+bool is_same_move(PackedMove left, PackedMove right) {
+  return left.get_tile() == right.get_tile() &&
+         left.get_target() == right.get_target() &&
+         left.get_promotion() == right.get_promotion();
+}
+
+// Captures only, like the quiescence search of AI, at most plies deep.
+int quiesce(Board& board, int alpha, int beta, int plies) {
+  const int score{AI::evaluate(board)};
+  if (score >= beta) {
+    return beta;
+  }
+  alpha = std::max(alpha, score);
+  if (plies == 0) {
+    return alpha;
+  }
+
+  Moves moves;
+  board.generate_all_legal_moves(moves, true);
+  AI::order_moves(board, moves);
+  for (const PackedMove move : moves) {
+    board.make_move(move);
+    const int move_score{-quiesce(board, -beta, -alpha, plies - 1)};
+    board.undo();
+    if (move_score >= beta) {
+      return beta;
+    }
+    alpha = std::max(alpha, move_score);
+  }
+  return alpha;
+}
+}  // namespace
+
+MctsAI::MctsAI(const MctsOptions& options)
+    : options_{options},
+      capacity_{options.tree_mb * 1024 * 1024 / sizeof(Node)},
+      worker_{std::bind_front(&MctsAI::run, this)} {
+  assert(options.threads >= 1);
+  tree_ = std::make_unique<Node[]>(capacity_);
+  LOG("MCTS", "Thread started");
+}
+
+std::future<Move> MctsAI::think(const Board& board,
+                                const SearchLimits& limits) {
+  std::future<Move> future;
+  {
+    const std::scoped_lock lock{mutex_};
+    assert(!has_request_);
+    board_ = board;
+    limits_ = limits;
+    promise_ = {};
+    future = promise_.get_future();
+    stop_ = false;
+    has_request_ = true;
+  }
+  condition_.notify_one();
+  return future;
+}
+
+void MctsAI::clear() {
+  const std::scoped_lock lock{mutex_};
+  assert(!has_request_);
+  size_ = 0;
+}
+
+void MctsAI::run(const std::stop_token& stop_token) {
+  while (true) {
+    {
+      std::unique_lock lock{mutex_};
+      if (!condition_.wait(lock, stop_token, [this] { return has_request_; })) {
+        break;
+      }
+    }
+    const Move best_move{search_root()};
+    {
+      const std::scoped_lock lock{mutex_};
+      has_request_ = false;
+      promise_.set_value(best_move);
+    }
+  }
+  LOG("MCTS", "Thread stopped");
+}
+
+Move MctsAI::search_root() {
+  assert(!board_.is_in_checkmate() && !board_.is_in_draw());
+  const auto start{std::chrono::high_resolution_clock::now()};
+  reuse_tree();
+  Node& root{tree_[root_]};
+  if (root.state.load(std::memory_order_relaxed) != Node::State::Expanded) {
+    [[maybe_unused]] const bool is_expanded{expand(root, board_)};
+    assert(is_expanded);
+  }
+
+  playouts_ = 0;
+  is_searching_ = true;
+  {
+    std::vector<std::jthread> threads;
+    for (unsigned i = 0; i < options_.threads; i++) {
+      threads.emplace_back(std::bind_front(&MctsAI::search, this, i + 1));
+    }
+    auto progress_time{start + k_progress_interval};
+    while (is_searching()) {
+      std::this_thread::sleep_for(k_poll_interval);
+      const auto now{std::chrono::high_resolution_clock::now()};
+      if (limits_.time && now - start > *limits_.time) {
+        break;
+      }
+      if (now >= progress_time) {
+        publish_progress(
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - start));
+        progress_time += k_progress_interval;
+      }
+    }
+    is_searching_ = false;
+  }
+  nodes_ = playouts_;
+  publish_progress(std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::high_resolution_clock::now() - start));
+
+  const Node* best{};
+  for (uint32_t i = 0; i < root.child_count; i++) {
+    const Node& child{tree_[root.first_child + i]};
+    if (best == nullptr || child.visits > best->visits) {
+      best = &child;
+    }
+  }
+  if (best == nullptr) {
+    // The root could not be expanded, the tree is full.
+    Moves moves;
+    board_.generate_all_legal_moves(moves);
+    assert(moves.size != 0);
+    return moves.data[0];
+  }
+  return best->move;
+}
+
+void MctsAI::reuse_tree() {
+  // Looks for the previous root up to two moves back.
+  std::optional<uint32_t> new_root;
+  if (size_ != 0) {
+    Board board{board_};
+    std::vector<PackedMove> moves;
+    while (board.get_key() != root_key_ && moves.size() < 2 &&
+           !board.get_records().empty()) {
+      moves.push_back(board.get_records().back().move);
+      board.undo();
+    }
+    if (board.get_key() == root_key_) {
+      new_root = root_;
+    }
+    for (auto it = moves.rbegin(); new_root && it != moves.rend(); ++it) {
+      const Node& node{tree_[*new_root]};
+      new_root.reset();
+      if (node.state.load(std::memory_order_relaxed) ==
+          Node::State::Expanded) {
+        for (uint32_t i = 0; i < node.child_count; i++) {
+          if (is_same_move(tree_[node.first_child + i].move, *it)) {
+            new_root = node.first_child + i;
+          }
+        }
+      }
+    }
+  }
+
+  root_ = 0;
+  root_key_ = board_.get_key();
+  if (!new_root) {
+    tree_[0].reset({}, 1.0F);
+    size_ = 1;
+    return;
+  }
+
+  // Copies the subtree breadth first to the start of the arena, which keeps
+  // the children of each node next to each other.
+  struct Saved {
+    uint32_t index{};
+    PackedMove move;
+    float prior{};
+    uint32_t visits{};
+    double value_sum{};
+    bool is_expanded{};
+    uint8_t child_count{};
+    uint32_t first_child{};
+  };
+  std::vector<Saved> saved;
+  auto save = [&](uint32_t index) {
+    const Node& node{tree_[index]};
+    saved.push_back({.index = index,
+                     .move = node.move,
+                     .prior = node.prior,
+                     .visits = node.visits,
+                     .value_sum = node.value_sum,
+                     .is_expanded = node.state == Node::State::Expanded,
+                     .child_count = node.child_count,
+                     .first_child = 0});
+  };
+  save(*new_root);
+  for (size_t i = 0; i < saved.size(); i++) {
+    if (saved[i].is_expanded) {
+      const uint32_t first_child{tree_[saved[i].index].first_child};
+      saved[i].first_child = static_cast<uint32_t>(saved.size());
+      for (uint32_t child = 0; child < saved[i].child_count; child++) {
+        save(first_child + child);
+      }
+    }
+  }
+  for (size_t i = 0; i < saved.size(); i++) {
+    Node& node{tree_[i]};
+    node.reset(saved[i].move, saved[i].prior);
+    if (saved[i].is_expanded) {
+      node.state = Node::State::Expanded;
+      node.child_count = saved[i].child_count;
+      node.first_child = saved[i].first_child;
+    }
+    node.visits = saved[i].visits;
+    node.value_sum = saved[i].value_sum;
+  }
+  size_ = saved.size();
+}
+
+void MctsAI::search(uint64_t seed) {
+  std::mt19937_64 random{seed};
+  std::vector<uint32_t> path;
+  path.reserve(k_max_path);
+  while (is_searching()) {
+    Board board{board_};
+    playout(board, path, random);
+    playouts_++;
+  }
+}
+
+void MctsAI::playout(Board& board, std::vector<uint32_t>& path,
+                     std::mt19937_64& random) {
+  path.clear();
+  uint32_t index{root_};
+  double value{};
+  while (true) {
+    Node& node{tree_[index]};
+    node.virtual_losses++;
+    path.push_back(index);
+
+    // value is from the view of the side to move.
+    if (board.is_in_checkmate()) {
+      value = -1.0;
+      break;
+    }
+    if (board.is_in_draw() || (path.size() > 1 && board.is_repetition())) {
+      value = 0.0;
+      break;
+    }
+    Node::State state{node.state.load(std::memory_order_acquire)};
+    if (state == Node::State::Leaf && path.size() < k_max_path &&
+        node.state.compare_exchange_strong(state, Node::State::Expanding,
+                                           std::memory_order_relaxed)) {
+      if (!expand(node, board)) {
+        node.state.store(Node::State::Leaf, std::memory_order_relaxed);
+      }
+      value = evaluate_leaf(board, static_cast<int>(path.size()) - 1, random);
+      break;
+    }
+    // Another thread is expanding it.
+    if (state != Node::State::Expanded) {
+      value = evaluate_leaf(board, static_cast<int>(path.size()) - 1, random);
+      break;
+    }
+    index = select_child(node);
+    board.make_move(tree_[index].move);
+  }
+
+  // Each node keeps the results of the side that moved into it.
+  double result{-value};
+  for (auto it = path.rbegin(); it != path.rend(); ++it) {
+    Node& node{tree_[*it]};
+    node.value_sum.fetch_add(result, std::memory_order_relaxed);
+    node.visits.fetch_add(1, std::memory_order_relaxed);
+    node.virtual_losses.fetch_sub(1, std::memory_order_relaxed);
+    result = -result;
+  }
+}
+
+bool MctsAI::expand(Node& node, Board& board) {
+  Moves moves;
+  board.generate_all_legal_moves(moves);
+  const auto count{static_cast<size_t>(moves.size)};
+  if (size_.load(std::memory_order_relaxed) + count > capacity_) {
+    return false;
+  }
+  const size_t first{size_.fetch_add(count)};
+  if (first + count > capacity_) {
+    return false;
+  }
+
+  // A softmax over the evaluation after each move.
+  std::array<float, Moves::k_capacity> priors{};
+  float max{-std::numeric_limits<float>::infinity()};
+  for (size_t i = 0; i < count; i++) {
+    board.make_move(moves.data[i]);
+    priors[i] = static_cast<float>(-AI::evaluate(board));
+    board.undo();
+    max = std::max(max, priors[i]);
+  }
+  float sum{};
+  for (size_t i = 0; i < count; i++) {
+    priors[i] = std::exp((priors[i] - max) / k_prior_temperature);
+    sum += priors[i];
+  }
+  for (size_t i = 0; i < count; i++) {
+    tree_[first + i].reset(moves.data[i], priors[i] / sum);
+  }
+
+  node.first_child = static_cast<uint32_t>(first);
+  node.child_count = static_cast<uint8_t>(count);
+  node.state.store(Node::State::Expanded, std::memory_order_release);
+  return true;
+}
+
+uint32_t MctsAI::select_child(const Node& node) const {
+  // Virtual losses count as visits the side to move lost.
+  const uint32_t parent_visits{
+      node.visits.load(std::memory_order_relaxed) +
+      node.virtual_losses.load(std::memory_order_relaxed)};
+  const double exploration{k_exploration *
+                           std::sqrt(std::max(parent_visits, 1U))};
+  uint32_t best{};
+  double best_score{-std::numeric_limits<double>::infinity()};
+  for (uint32_t i = 0; i < node.child_count; i++) {
+    const Node& child{tree_[node.first_child + i]};
+    const uint32_t virtual_losses{
+        child.virtual_losses.load(std::memory_order_relaxed)};
+    const uint32_t visits{child.visits.load(std::memory_order_relaxed) +
+                          virtual_losses};
+    const double mean{
+        visits == 0
+            ? 0.0
+            : (child.value_sum.load(std::memory_order_relaxed) -
+               virtual_losses) /
+                  visits};
+    const double score{mean + exploration * static_cast<double>(child.prior) /
+                                     (1 + visits)};
+    if (score > best_score) {
+      best_score = score;
+      best = node.first_child + i;
+    }
+  }
+  return best;
+}
+
+// ply counts the moves from the root to the leaf.
+double MctsAI::evaluate_leaf(Board& board, int ply,
+                             std::mt19937_64& random) const {
+  const int max_plies{std::min(options_.playout_plies, k_max_plies - ply)};
+  int plies{};
+  for (; plies < max_plies && !board.is_in_checkmate() && !board.is_in_draw();
+       plies++) {
+    Moves moves;
+    board.generate_all_legal_moves(moves);
+    board.make_move(moves.data[static_cast<size_t>(
+        std::uniform_int_distribution{0, moves.size - 1}(random))]);
+  }
+  const double value{to_value(
+      quiesce(board, -1000000, 1000000, k_max_quiescence_plies))};
+  for (int i = 0; i < plies; i++) {
+    board.undo();
+  }
+  return plies % 2 == 0 ? value : -value;
+}
+
+void MctsAI::publish_progress(std::chrono::milliseconds time) {
+  SearchProgress progress{.nodes = playouts_,
+                          .nps = playouts_ * 1000 /
+                                 static_cast<uint64_t>(time.count() + 1),
+                          .time = time};
+  const Node* node{&tree_[root_]};
+  while (progress.pv_size < SearchProgress::k_max_pv_size &&
+         node->state.load(std::memory_order_acquire) ==
+             Node::State::Expanded) {
+    const Node* best{};
+    for (uint32_t i = 0; i < node->child_count; i++) {
+      const Node& child{tree_[node->first_child + i]};
+      if (best == nullptr || child.visits > best->visits) {
+        best = &child;
+      }
+    }
+    if (best == nullptr || best->visits == 0) {
+      break;
+    }
+    if (progress.pv_size == 0) {
+      progress.score = to_score(best->value_sum / best->visits);
+    }
+    progress.pv[static_cast<size_t>(progress.pv_size++)] = best->move;
+    node = best;
+  }
+  progress.depth = progress.pv_size;
+  progress_.push(progress);
+}
@@ -0,0 +1,47 @@
+#include "packed_position_file.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+PackedPositionReader::PackedPositionReader(const std::filesystem::path& path)
+    : file_{path} {
+  if (file_.get_bytes().size() % sizeof(PackedPosition) != 0) {
+    LOGF("PackedPosition", "{} is not a packed position file",
+         path.string());
+    file_.close();
+  }
+}
+
+PackedPositionWriter::PackedPositionWriter(const std::filesystem::path& path)
+    : file_{path, MappedFile::Mode::ReadWrite} {
+  if (file_.is_open() && !file_.resize(0)) {
+    LOGF("PackedPosition", "Failed to truncate {}", path.string());
+  }
+}
+
+bool PackedPositionWriter::write(std::span<const PackedPosition> positions) {
+  if (!file_.is_open()) {
+    return false;
+  }
+  if (size_ + positions.size() > capacity_) {
+    capacity_ = std::max({k_min_capacity, 2 * capacity_,
+                          size_ + positions.size()});
+    if (!file_.resize(capacity_ * sizeof(PackedPosition))) {
+      return false;
+    }
+  }
+  std::byte* end{file_.get_writable_bytes().data() +
+                 size_ * sizeof(PackedPosition)};
+  std::memcpy(end, positions.data(), positions.size_bytes());
+  size_ += positions.size();
+  return true;
+}
+
+void PackedPositionWriter::close() {
+  if (file_.is_open() && capacity_ != size_) {
+    file_.resize(size_ * sizeof(PackedPosition));
+  }
+  file_.close();
+  size_ = 0;
+  capacity_ = 0;
+}
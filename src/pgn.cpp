@@ -0,0 +1,305 @@
+#include "pgn.hpp"
+
+#include <atomic>
+
+namespace {
+constexpr std::string_view k_whitespace{" \t\r\n"};
+constexpr std::array<std::string_view, 7> k_seven_tag_roster{
+    "Event", "Site", "Date", "Round", "White", "Black", "Result"};
+constexpr size_t k_max_line_length{80};
+constexpr size_t k_replay_chunk_size{64};
+
+std::string_view trim(std::string_view text) {
+  const size_t begin{text.find_first_not_of(k_whitespace)};
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  return text.substr(begin, text.find_last_not_of(k_whitespace) - begin + 1);
+}
+
+bool is_termination(std::string_view token) {
+  return token == "1-0" || token == "0-1" || token == "1/2-1/2" ||
+         token == "*";
+}
+
+std::optional<int> parse_result(std::string_view result) {
+  if (result == "1-0") {
+    return 1;
+  }
+  if (result == "0-1") {
+    return -1;
+  }
+  if (result == "1/2-1/2") {
+    return 0;
+  }
+  return std::nullopt;
+}
+}  // namespace
+
+std::string_view PgnGame::get_tag(std::string_view name) const {
+  size_t offset{};
+  while (offset < tags.size()) {
+    const size_t end{std::min(tags.find('\n', offset), tags.size())};
+    const std::string_view line{trim(tags.substr(offset, end - offset))};
+    offset = end + 1;
+
+    // [Name "Value"]
+    if (line.size() < name.size() + 4 || line[0] != '[' ||
+        line.substr(1, name.size()) != name ||
+        k_whitespace.find(line[name.size() + 1]) == std::string_view::npos) {
+      continue;
+    }
+    const size_t begin{line.find('"')};
+    const size_t last{line.rfind('"')};
+    if (begin == std::string_view::npos || begin == last) {
+      return {};
+    }
+    return line.substr(begin + 1, last - begin - 1);
+  }
+  return {};
+}
+
+std::optional<int> PgnGame::get_result() const {
+  if (const auto result = parse_result(get_tag("Result"))) {
+    return result;
+  }
+  const std::string_view text{trim(movetext)};
+  const size_t begin{text.find_last_of(k_whitespace)};
+  return parse_result(
+      begin == std::string_view::npos ? text : text.substr(begin + 1));
+}
+
+std::optional<PgnGame> PgnReader::next() {
+  const std::string_view text{file_.get_text()};
+  constexpr size_t k_none{std::string_view::npos};
+  size_t tags_begin{k_none};
+  size_t tags_end{};
+  size_t movetext_begin{k_none};
+  size_t movetext_end{};
+  while (offset_ < text.size()) {
+    const size_t end{std::min(text.find('\n', offset_), text.size())};
+    const std::string_view line{trim(text.substr(offset_, end - offset_))};
+    if (!line.empty() && line.front() == '[') {
+      if (movetext_begin != k_none) {
+        break;  // Tags of the next game
+      }
+      if (tags_begin == k_none) {
+        tags_begin = offset_;
+      }
+      tags_end = end;
+    } else if (!line.empty() && line.front() != '%') {
+      if (movetext_begin == k_none) {
+        movetext_begin = offset_;
+      }
+      movetext_end = end;
+      const size_t last_token{line.find_last_of(k_whitespace)};
+      if (is_termination(last_token == std::string_view::npos
+                             ? line
+                             : line.substr(last_token + 1))) {
+        offset_ = end + 1;
+        break;
+      }
+    }
+    offset_ = end + 1;
+  }
+
+  if (tags_begin == k_none && movetext_begin == k_none) {
+    return std::nullopt;
+  }
+  PgnGame game;
+  game.index = game_count_++;
+  if (tags_begin != k_none) {
+    game.tags = text.substr(tags_begin, tags_end - tags_begin);
+  }
+  if (movetext_begin != k_none) {
+    game.movetext = text.substr(movetext_begin, movetext_end - movetext_begin);
+  }
+  return game;
+}
+
+bool replay_pgn_game(const PgnGame& game, Board& board,
+                     const PgnVisitor& visitor) {
+  if (const std::string_view fen{game.get_tag("FEN")}; fen.empty()) {
+    board.load_fen();
+  } else if (board.load_fen(fen)) {
+    return false;
+  }
+
+  const std::string_view text{game.movetext};
+  int variation_depth{};
+  size_t offset{};
+  while (offset < text.size()) {
+    const char ch{text[offset]};
+    if (ch == '{' || ch == ';') {
+      offset = std::min(text.find(ch == '{' ? '}' : '\n', offset), text.size());
+      offset++;
+      continue;
+    }
+    if (ch == '(' || ch == ')') {
+      // A stray ')' must not make later variation moves the main line.
+      variation_depth = std::max(variation_depth + (ch == '(' ? 1 : -1), 0);
+      offset++;
+      continue;
+    }
+    // A stray '}' is skipped like whitespace.
+    if (ch == '}' || k_whitespace.find(ch) != std::string_view::npos) {
+      offset++;
+      continue;
+    }
+
+    const size_t end{
+        std::min(text.find_first_of(" \t\r\n{}();", offset), text.size())};
+    std::string_view token{text.substr(offset, end - offset)};
+    offset = end;
+    if (variation_depth > 0 || token.front() == '$' || is_termination(token)) {
+      continue;
+    }
+
+    // Move numbers like "12." or "12..." may stick to the move.
+    if (const size_t digits_end{token.find_first_not_of("0123456789")};
+        digits_end == std::string_view::npos) {
+      continue;
+    } else if (digits_end != 0 && token[digits_end] == '.') {
+      const size_t move_begin{token.find_first_not_of('.', digits_end)};
+      if (move_begin == std::string_view::npos) {
+        continue;
+      }
+      token.remove_prefix(move_begin);
+    }
+
+    const std::optional<PackedMove> move{parse_san(board, token)};
+    if (!move) {
+      return false;
+    }
+    visitor(game, board, *move);
+    board.play_move(*move);
+  }
+  visitor(game, board, PackedMove{});
+  return true;
+}
+
+PgnReplayResult replay_pgn_games(std::span<const PgnGame> games,
+                                 const PgnVisitor& visitor,
+                                 unsigned thread_count) {
+  std::atomic<size_t> next_game{};
+  std::atomic<size_t> positions{};
+  std::atomic<size_t> failed_games{};
+  auto replay = [&] {
+    Board board;
+    size_t thread_positions{};
+    size_t thread_failed_games{};
+    const PgnVisitor counting_visitor{
+        [&](const PgnGame& game, const Board& position, PackedMove move) {
+          thread_positions++;
+          visitor(game, position, move);
+        }};
+    while (true) {
+      const size_t begin{next_game.fetch_add(k_replay_chunk_size)};
+      if (begin >= games.size()) {
+        break;
+      }
+      const size_t end{std::min(begin + k_replay_chunk_size, games.size())};
+      for (size_t i = begin; i < end; i++) {
+        if (!replay_pgn_game(games[i], board, counting_visitor)) {
+          thread_failed_games++;
+        }
+      }
+    }
+    positions += thread_positions;
+    failed_games += thread_failed_games;
+  };
+
+  {
+    std::vector<std::jthread> threads;
+    for (unsigned i = 1; i < thread_count; i++) {
+      threads.emplace_back(replay);
+    }
+    replay();
+  }
+  return {games.size(), positions, failed_games};
+}
+
+std::string to_pgn(const Board& board, std::span<const PgnTag> tags) {
+  // Moves made with make_move are not part of the game.
+  Board played{board};
+  for (int i = board.get_search_depth(); i > 0; i--) {
+    played.undo();
+  }
+
+  std::vector<PackedMove> moves;
+  for (auto it = played.get_records().rbegin();
+       it != played.get_records().rend(); ++it) {
+    moves.push_back((*it).move);
+  }
+  std::reverse(moves.begin(), moves.end());
+
+  Board replay{played};
+  for (size_t i = 0; i < moves.size(); i++) {
+    replay.undo();
+  }
+  const std::string fen{replay.to_fen()};
+
+  auto find_tag = [&tags](std::string_view name) {
+    const auto it{std::find_if(
+        tags.begin(), tags.end(),
+        [name](const PgnTag& tag) { return tag.first == name; })};
+    return it == tags.end() ? std::nullopt : std::optional{it->second};
+  };
+
+  std::string_view result{"*"};
+  if (const auto tag = find_tag("Result")) {
+    result = *tag;
+  } else if (played.is_in_checkmate()) {
+    result = played.get_turn() == PieceColor::White ? "0-1" : "1-0";
+  } else if (played.is_in_draw()) {
+    result = "1/2-1/2";
+  }
+
+  std::string pgn;
+  for (const std::string_view name : k_seven_tag_roster) {
+    std::string_view value{name == "Date" ? "????.??.??" : "?"};
+    if (name == "Result") {
+      value = result;
+    } else if (const auto tag = find_tag(name)) {
+      value = *tag;
+    }
+    pgn += std::format("[{} \"{}\"]\n", name, value);
+  }
+  if (fen != Board{}.to_fen()) {
+    pgn += std::format("[SetUp \"1\"]\n[FEN \"{}\"]\n", fen);
+  }
+  for (const auto& [name, value] : tags) {
+    if (std::find(k_seven_tag_roster.begin(), k_seven_tag_roster.end(),
+                  name) == k_seven_tag_roster.end()) {
+      pgn += std::format("[{} \"{}\"]\n", name, value);
+    }
+  }
+  pgn += '\n';
+
+  size_t line_length{};
+  auto add_token = [&pgn, &line_length](std::string_view token) {
+    if (line_length != 0 &&
+        line_length + 1 + token.size() > k_max_line_length) {
+      pgn += '\n';
+      line_length = 0;
+    } else if (line_length != 0) {
+      pgn += ' ';
+      line_length++;
+    }
+    pgn += token;
+    line_length += token.size();
+  };
+  for (size_t i = 0; i < moves.size(); i++) {
+    const int fullmove_number{replay.get_fullmove_number()};
+    if (replay.get_turn() == PieceColor::White) {
+      add_token(std::format("{}.", fullmove_number));
+    } else if (i == 0) {
+      add_token(std::format("{}...", fullmove_number));
+    }
+    add_token(to_san(replay, moves[i]));
+    replay.play_move(moves[i]);
+  }
+  add_token(result);
+  pgn += '\n';
+  return pgn;
+}
@@ -0,0 +1,272 @@
+#include "position_index.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <queue>
+
+#include "pgn.hpp"
+
+namespace {
+constexpr std::array k_magic{'C', 'H', 'E', 'S', 'S', 'I', 'D', 'X'};
+constexpr size_t k_build_chunk_size{64};
+constexpr int8_t k_unknown_result{2};
+
+struct Header {
+  std::array<char, 8> magic{};
+  uint64_t move_count{};
+  uint64_t game_count{};
+  uint64_t reserved{};
+};
+
+static_assert(sizeof(Header) == 32);
+
+// A visited position, runs hold these sorted by key, move and game.
+struct Record {
+  uint64_t key{};
+  uint32_t game{};
+  PackedMove move{};
+  int8_t result{};
+
+  friend bool operator<(const Record& left, const Record& right) {
+    return std::tuple{left.key, left.move.get_data(), left.game} <
+           std::tuple{right.key, right.move.get_data(), right.game};
+  }
+};
+
+static_assert(sizeof(Record) == 16);
+
+template <typename T>
+bool write_values(std::ofstream& file, std::span<T> values) {
+  file.write(reinterpret_cast<const char*>(values.data()),
+             static_cast<std::streamsize>(values.size_bytes()));
+  return file.good();
+}
+
+template <typename T>
+std::span<const T> get_values(const MappedFile& file) {
+  const std::span<const std::byte> bytes{file.get_bytes()};
+  return {reinterpret_cast<const T*>(bytes.data()), bytes.size() / sizeof(T)};
+}
+
+// Merges the sorted runs, aggregating moves per key and collecting the
+// distinct games of each key.
+bool merge_runs(const std::vector<std::filesystem::path>& run_paths,
+                const std::filesystem::path& index_path) {
+  std::vector<MappedFile> runs;
+  for (const auto& run_path : run_paths) {
+    runs.emplace_back(run_path);
+    if (!runs.back().is_open()) {
+      return false;
+    }
+  }
+
+  using Cursor = std::pair<Record, size_t>;
+  auto is_after = [](const Cursor& left, const Cursor& right) {
+    return right.first < left.first;
+  };
+  std::priority_queue<Cursor, std::vector<Cursor>, decltype(is_after)> queue{
+      is_after};
+  std::vector<size_t> offsets(runs.size());
+  for (size_t i = 0; i < runs.size(); i++) {
+    if (const auto records = get_values<Record>(runs[i]); !records.empty()) {
+      queue.emplace(records[0], i);
+    }
+  }
+
+  std::filesystem::path games_path{index_path};
+  games_path += ".games";
+  std::ofstream index_file{index_path, std::ios::binary};
+  std::ofstream games_file{games_path, std::ios::binary};
+  Header header{.magic = k_magic};
+  write_values(index_file, std::span{&header, 1});
+
+  PositionMoveStats stats;
+  std::vector<uint32_t> games;
+  auto flush_stats = [&] {
+    if (stats.count != 0) {
+      write_values(index_file, std::span{&stats, 1});
+      header.move_count++;
+    }
+  };
+  auto flush_games = [&] {
+    std::sort(games.begin(), games.end());
+    games.erase(std::unique(games.begin(), games.end()), games.end());
+    for (const uint32_t game : games) {
+      const PositionGame position_game{stats.key, game};
+      write_values(games_file, std::span{&position_game, 1});
+    }
+    header.game_count += games.size();
+    games.clear();
+  };
+
+  while (!queue.empty()) {
+    const auto [record, run] = queue.top();
+    queue.pop();
+    if (const auto records = get_values<Record>(runs[run]);
+        ++offsets[run] < records.size()) {
+      queue.emplace(records[offsets[run]], run);
+    }
+
+    if (record.key != stats.key || record.move != stats.move) {
+      flush_stats();
+      if (record.key != stats.key) {
+        flush_games();
+      }
+      stats = {.key = record.key, .move = record.move};
+    }
+    stats.count++;
+    stats.white_wins += record.result == 1 ? 1 : 0;
+    stats.draws += record.result == 0 ? 1 : 0;
+    stats.black_wins += record.result == -1 ? 1 : 0;
+    games.push_back(record.game);
+  }
+  flush_stats();
+  flush_games();
+
+  games_file.close();
+  runs.clear();
+  {
+    std::ifstream games_input{games_path, std::ios::binary};
+    // Unlike operator<< with rdbuf, copies an empty file without failing.
+    std::copy(std::istreambuf_iterator<char>{games_input},
+              std::istreambuf_iterator<char>{},
+              std::ostreambuf_iterator<char>{index_file});
+  }
+  index_file.seekp(0);
+  write_values(index_file, std::span{&header, 1});
+  std::filesystem::remove(games_path);
+  return index_file.good();
+}
+}  // namespace
+
+PositionIndex::PositionIndex(const std::filesystem::path& path)
+    : file_{path} {
+  const std::span<const std::byte> bytes{file_.get_bytes()};
+  Header header;
+  if (bytes.size() >= sizeof(Header)) {
+    std::memcpy(&header, bytes.data(), sizeof(Header));
+  }
+  if (header.magic != k_magic ||
+      bytes.size() != sizeof(Header) +
+                          header.move_count * sizeof(PositionMoveStats) +
+                          header.game_count * sizeof(PositionGame)) {
+    LOGF("PositionIndex", "{} is not a position index", path.string());
+    file_.close();
+    return;
+  }
+
+  const std::byte* moves{bytes.data() + sizeof(Header)};
+  moves_ = {reinterpret_cast<const PositionMoveStats*>(moves),
+            header.move_count};
+  games_ = {reinterpret_cast<const PositionGame*>(
+                moves + header.move_count * sizeof(PositionMoveStats)),
+            header.game_count};
+}
+
+std::span<const PositionMoveStats> PositionIndex::find_moves(
+    uint64_t key) const {
+  const auto range{
+      std::ranges::equal_range(moves_, key, {}, &PositionMoveStats::key)};
+  return {range.begin(), range.end()};
+}
+
+std::span<const PositionGame> PositionIndex::find_games(uint64_t key) const {
+  const auto range{
+      std::ranges::equal_range(games_, key, {}, &PositionGame::key)};
+  return {range.begin(), range.end()};
+}
+
+bool build_position_index(const std::filesystem::path& pgn_path,
+                          const std::filesystem::path& index_path,
+                          unsigned thread_count, size_t run_size) {
+  PgnReader reader{pgn_path};
+  if (!reader.is_open()) {
+    LOGF("PositionIndex", "Failed to open {}", pgn_path.string());
+    return false;
+  }
+  std::vector<PgnGame> games;
+  while (const auto game = reader.next()) {
+    games.push_back(*game);
+  }
+
+  std::mutex run_paths_mutex;
+  std::vector<std::filesystem::path> run_paths;
+  std::atomic<bool> has_failed{};
+  std::atomic<size_t> failed_games{};
+  auto write_run = [&](std::vector<Record>& records) {
+    std::sort(records.begin(), records.end());
+    std::filesystem::path run_path{index_path};
+    {
+      const std::scoped_lock lock{run_paths_mutex};
+      run_path += std::format(".run{}", run_paths.size());
+      run_paths.push_back(run_path);
+    }
+    std::ofstream file{run_path, std::ios::binary};
+    if (!write_values(file, std::span<const Record>{records})) {
+      has_failed = true;
+    }
+    records.clear();
+  };
+
+  std::atomic<size_t> next_game{};
+  auto build_runs = [&] {
+    Board board;
+    std::vector<Record> records;
+    records.reserve(run_size);
+    // A game's positions join the run only once all of it replays.
+    std::vector<Record> game_records;
+    int8_t result{};
+    const PgnVisitor visitor{
+        [&](const PgnGame& game, const Board& position, PackedMove move) {
+          game_records.push_back({position.get_key(),
+                                  static_cast<uint32_t>(game.index), move,
+                                  result});
+        }};
+    while (true) {
+      const size_t begin{next_game.fetch_add(k_build_chunk_size)};
+      if (begin >= games.size()) {
+        break;
+      }
+      const size_t end{std::min(begin + k_build_chunk_size, games.size())};
+      for (size_t i = begin; i < end; i++) {
+        result = static_cast<int8_t>(
+            games[i].get_result().value_or(k_unknown_result));
+        game_records.clear();
+        if (!replay_pgn_game(games[i], board, visitor)) {
+          failed_games++;
+          continue;
+        }
+        records.insert(records.end(), game_records.begin(),
+                       game_records.end());
+        if (records.size() >= run_size) {
+          write_run(records);
+        }
+      }
+    }
+    if (!records.empty()) {
+      write_run(records);
+    }
+  };
+
+  {
+    std::vector<std::jthread> threads;
+    for (unsigned i = 1; i < thread_count; i++) {
+      threads.emplace_back(build_runs);
+    }
+    build_runs();
+  }
+  if (failed_games != 0) {
+    LOGF("PositionIndex", "{} of {} games have illegal moves",
+         failed_games.load(), games.size());
+  }
+
+  const bool is_merged{!has_failed && merge_runs(run_paths, index_path)};
+  for (const auto& run_path : run_paths) {
+    std::filesystem::remove(run_path);
+  }
+  return is_merged;
+}
@@ -0,0 +1,188 @@
+#include "san.hpp"
+
+namespace {
+char get_piece_letter(PieceType type) {
+  return " KQBNRP"[to_underlying(type)];
+}
+
+PieceType get_piece_letter_type(char letter) {
+  switch (letter) {
+    case 'K':
+      return PieceType::King;
+    case 'Q':
+      return PieceType::Queen;
+    case 'B':
+      return PieceType::Bishop;
+    case 'N':
+      return PieceType::Knight;
+    case 'R':
+      return PieceType::Rook;
+    default:
+      return PieceType::None;
+  }
+}
+
+bool is_column(char ch) { return ch >= 'a' && ch <= 'h'; }
+bool is_row(char ch) { return ch >= '1' && ch <= '8'; }
+
+// Legal moves of the side to move's pieces of type onto target.
+void generate_moves_to(Board& board, Moves& moves, PieceType type,
+                       int target) {
+  Bitboard pieces{board.get_bitboard(board.get_turn(), type)};
+  while (pieces != 0) {
+    const int tile{pop_tile(pieces)};
+    const int end{moves.size};
+    board.generate_legal_moves(moves, tile);
+    const auto last{std::remove_if(
+        moves.begin() + end, moves.end(),
+        [target](PackedMove move) { return move.get_target() != target; })};
+    moves.size = static_cast<int>(last - moves.begin());
+  }
+}
+}  // namespace
+
+std::string to_san(Board& board, PackedMove move) {
+  std::string san;
+  const int tile{move.get_tile()};
+  const int target{move.get_target()};
+  const PieceType type{board.get_type(tile)};
+
+  // Moves played from a Move carry no capture or castling flags, the
+  // generated move with the same tiles has them.
+  Moves moves;
+  board.generate_legal_moves(moves, tile);
+  for (const PackedMove legal_move : moves) {
+    if (legal_move.get_target() == target &&
+        legal_move.get_promotion() == move.get_promotion()) {
+      move = legal_move;
+      break;
+    }
+  }
+
+  if (move.is_castling()) {
+    san = move.get_flags() == PackedMove::ShortCastling ? "O-O" : "O-O-O";
+  } else {
+    if (type == PieceType::Pawn) {
+      if (move.is_capture()) {
+        san += static_cast<char>('a' + get_tile_column(tile));
+      }
+    } else {
+      san += get_piece_letter(type);
+
+      Moves others;
+      generate_moves_to(board, others, type, target);
+      bool is_ambiguous{};
+      bool is_column_ambiguous{};
+      bool is_row_ambiguous{};
+      for (const PackedMove other : others) {
+        if (other.get_tile() == tile) {
+          continue;
+        }
+        is_ambiguous = true;
+        is_column_ambiguous |=
+            get_tile_column(other.get_tile()) == get_tile_column(tile);
+        is_row_ambiguous |=
+            get_tile_row(other.get_tile()) == get_tile_row(tile);
+      }
+      if (is_ambiguous && (!is_column_ambiguous || is_row_ambiguous)) {
+        san += static_cast<char>('a' + get_tile_column(tile));
+      }
+      if (is_column_ambiguous) {
+        san += static_cast<char>('1' + get_tile_row(tile));
+      }
+    }
+    if (move.is_capture()) {
+      san += 'x';
+    }
+    san += static_cast<char>('a' + get_tile_column(target));
+    san += static_cast<char>('1' + get_tile_row(target));
+    if (move.is_promotion()) {
+      san += '=';
+      san += get_piece_letter(move.get_promotion());
+    }
+  }
+
+  board.make_move(move);
+  if (board.is_in_checkmate()) {
+    san += '#';
+  } else if (board.is_in_check()) {
+    san += '+';
+  }
+  board.undo();
+  return san;
+}
+
+std::optional<PackedMove> parse_san(Board& board, std::string_view san) {
+  while (!san.empty() && (san.back() == '+' || san.back() == '#' ||
+                          san.back() == '!' || san.back() == '?')) {
+    san.remove_suffix(1);
+  }
+
+  if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+    const bool is_short{san.size() == 3};
+    Moves moves;
+    const int king_tile{board.get_turn() == PieceColor::White ? 4 : 60};
+    board.generate_legal_moves(moves, king_tile);
+    for (const PackedMove move : moves) {
+      if (move.get_flags() == (is_short ? PackedMove::ShortCastling
+                                        : PackedMove::LongCastling)) {
+        return move;
+      }
+    }
+    return std::nullopt;
+  }
+
+  PieceType promotion{};
+  if (!san.empty() && san.back() != 'K' &&
+      get_piece_letter_type(san.back()) != PieceType::None) {
+    promotion = get_piece_letter_type(san.back());
+    san.remove_suffix(1);
+    if (!san.empty() && san.back() == '=') {
+      san.remove_suffix(1);
+    }
+  }
+
+  if (san.size() < 2 || !is_column(san[san.size() - 2]) ||
+      !is_row(san.back())) {
+    return std::nullopt;
+  }
+  const int target{8 * (san.back() - '1') + (san[san.size() - 2] - 'a')};
+  san.remove_suffix(2);
+
+  PieceType type{PieceType::Pawn};
+  if (!san.empty() && get_piece_letter_type(san.front()) != PieceType::None) {
+    type = get_piece_letter_type(san.front());
+    san.remove_prefix(1);
+  }
+  if (!san.empty() && san.back() == 'x') {
+    san.remove_suffix(1);
+  }
+
+  int column{-1};
+  int row{-1};
+  for (const char ch : san) {
+    if (is_column(ch)) {
+      column = ch - 'a';
+    } else if (is_row(ch)) {
+      row = ch - '1';
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  Moves moves;
+  generate_moves_to(board, moves, type, target);
+  std::optional<PackedMove> match;
+  for (const PackedMove move : moves) {
+    if (move.get_promotion() != promotion ||
+        (column != -1 && get_tile_column(move.get_tile()) != column) ||
+        (row != -1 && get_tile_row(move.get_tile()) != row)) {
+      continue;
+    }
+    if (match) {
+      return std::nullopt;
+    }
+    match = move;
+  }
+  return match;
+}
@@ -0,0 +1,52 @@
+#include "search_stats.hpp"
+
+#include <iterator>
+
+namespace {
+double get_rate(uint64_t count, uint64_t total) {
+  return total == 0 ? 0.0
+                    : static_cast<double>(count) / static_cast<double>(total);
+}
+}  // namespace
+
+std::string SearchStats::to_json(uint64_t nodes,
+                                 std::chrono::microseconds time) const {
+  if constexpr (!k_enabled) {
+    return {};
+  }
+
+  // Nodes of each iteration, the recorded counts are cumulative.
+  std::vector<uint64_t> depth_nodes;
+  for (size_t i = 0; i < depths_.size(); i++) {
+    depth_nodes.push_back(depths_[i].nodes -
+                          (i == 0 ? 0 : depths_[i - 1].nodes));
+  }
+  // Ratio of the nodes of the last two completed iterations.
+  const double effective_branching_factor{
+      depth_nodes.size() < 2
+          ? 0.0
+          : get_rate(depth_nodes.back(), depth_nodes[depth_nodes.size() - 2])};
+
+  std::string json;
+  auto out{std::back_inserter(json)};
+  std::format_to(
+      out,
+      R"({{"nodes":{},"quiescence_nodes":{},"time_us":{},"nps":{},)"
+      R"("ebf":{:.2f},"first_move_cutoff_rate":{:.3f},)"
+      R"("tt_hit_rate":{:.3f},"tt_store_rate":{:.3f},"depths":[)",
+      nodes, quiescence_nodes_, time.count(),
+      nodes * 1000000 / static_cast<uint64_t>(time.count() + 1),
+      effective_branching_factor,
+      get_rate(first_move_beta_cutoffs_, beta_cutoffs_),
+      get_rate(table_hits_, table_probes_),
+      get_rate(table_stores_, table_store_attempts_));
+  for (size_t i = 0; i < depths_.size(); i++) {
+    const auto previous_time{i == 0 ? std::chrono::microseconds{}
+                                    : depths_[i - 1].time};
+    std::format_to(out, R"({}{{"depth":{},"nodes":{},"time_us":{}}})",
+                   i == 0 ? "" : ",", depths_[i].depth, depth_nodes[i],
+                   (depths_[i].time - previous_time).count());
+  }
+  json += "]}";
+  return json;
+}
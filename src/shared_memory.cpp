@@ -0,0 +1,100 @@
+#include "shared_memory.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SharedMemory& SharedMemory::operator=(SharedMemory&& other) noexcept {
+  if (this != &other) {
+    close();
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+#ifdef _WIN32
+    std::swap(mapping_, other.mapping_);
+#endif
+  }
+  return *this;
+}
+
+#ifdef _WIN32
+SharedMemory::SharedMemory(std::string_view name, size_t size) {
+  const std::filesystem::path path{std::format("Local\\{}", name)};
+  const auto wide_size{static_cast<uint64_t>(size)};
+  mapping_ = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                static_cast<DWORD>(wide_size >> 32),
+                                static_cast<DWORD>(wide_size), path.c_str());
+  if (mapping_ == nullptr) {
+    return;
+  }
+  data_ = static_cast<std::byte*>(
+      MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+  MEMORY_BASIC_INFORMATION information{};
+  if (data_ == nullptr ||
+      VirtualQuery(data_, &information, sizeof(information)) == 0) {
+    close();
+    return;
+  }
+  size_ = information.RegionSize;
+}
+
+void SharedMemory::close() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_ != nullptr) {
+    CloseHandle(mapping_);
+  }
+  data_ = nullptr;
+  mapping_ = nullptr;
+  size_ = 0;
+}
+#else
+SharedMemory::SharedMemory(std::string_view name, size_t size) {
+  const std::string path{std::format("/{}", name)};
+  const int file{shm_open(path.c_str(), O_RDWR | O_CREAT, 0600)};
+  if (file == -1) {
+    return;
+  }
+  // Only the process that created the memory sizes it.
+  flock(file, LOCK_EX);
+  struct stat status {};
+  bool is_valid{fstat(file, &status) != -1};
+  if (is_valid && status.st_size == 0) {
+    is_valid = ftruncate(file, static_cast<off_t>(size)) != -1;
+    status.st_size = static_cast<off_t>(size);
+  }
+  flock(file, LOCK_UN);
+
+  if (is_valid) {
+    const auto mapped_size{static_cast<size_t>(status.st_size)};
+    void* data{mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    file, 0)};
+    if (data != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+      // Backed by transparent huge pages where the kernel allows them for
+      // shared memory, which saves most TLB misses on random probes.
+      madvise(data, mapped_size, MADV_HUGEPAGE);
+#endif
+      data_ = static_cast<std::byte*>(data);
+      size_ = mapped_size;
+    }
+  }
+  ::close(file);
+}
+
+void SharedMemory::close() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+#endif
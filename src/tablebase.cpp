@@ -0,0 +1,834 @@
+#include "tablebase.hpp"
+
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <span>
+
+namespace {
+constexpr std::array k_magic{'C', 'H', 'E', 'S', 'S', 'T', 'B', 'L'};
+constexpr std::string_view k_extension{".tb"};
+constexpr int k_max_plies{255};
+constexpr size_t k_chunk_size{4096};
+// Indexed by the piece type minus 1.
+constexpr std::string_view k_piece_letters{"KQBNRP"};
+// Order of the pieces after the king in a material name.
+constexpr std::array k_piece_order{PieceType::Queen, PieceType::Rook,
+                                   PieceType::Bishop, PieceType::Knight,
+                                   PieceType::Pawn};
+// Pawn units by piece type, to put the stronger side first.
+constexpr std::array k_piece_weights{0, 0, 9, 3, 3, 5, 1};
+
+struct Header {
+  std::array<char, 8> magic{};
+  std::array<Piece, Tablebase::k_max_pieces> pieces{};
+  uint32_t piece_count{};
+  uint64_t size{};
+  uint64_t reserved{};
+};
+
+static_assert(sizeof(Header) == 32);
+
+struct Material {
+  std::array<Piece, Tablebase::k_max_pieces> pieces{};
+  int count{};
+};
+
+// Tiles the white king is limited to, with and without pawns.
+struct KingTiles {
+  std::array<int8_t, 64> indices{};
+  std::array<int8_t, 32> tiles{};
+  int count{};
+};
+
+constexpr KingTiles make_king_tiles(bool has_pawns) {
+  KingTiles king_tiles;
+  for (int tile = 0; tile < 64; tile++) {
+    const int row{get_tile_row(tile)};
+    const int column{get_tile_column(tile)};
+    king_tiles.indices[static_cast<size_t>(tile)] = -1;
+    if (column < 4 && (has_pawns || (row < 4 && row <= column))) {
+      king_tiles.indices[static_cast<size_t>(tile)] =
+          static_cast<int8_t>(king_tiles.count);
+      king_tiles.tiles[static_cast<size_t>(king_tiles.count++)] =
+          static_cast<int8_t>(tile);
+    }
+  }
+  return king_tiles;
+}
+
+constexpr std::array k_king_tiles{make_king_tiles(false),
+                                  make_king_tiles(true)};
+
+static_assert(k_king_tiles[0].count == 10 && k_king_tiles[1].count == 32);
+
+const KingTiles& get_king_tiles(bool has_pawns) {
+  return k_king_tiles[has_pawns ? 1 : 0];
+}
+
+// Bit 0 mirrors the columns, bit 1 the rows and bit 2 then swaps rows and
+// columns.
+constexpr int transform(int tile, unsigned symmetry) {
+  if ((symmetry & 1U) != 0) {
+    tile ^= 7;
+  }
+  if ((symmetry & 2U) != 0) {
+    tile ^= 56;
+  }
+  if ((symmetry & 4U) != 0) {
+    tile = get_tile_column(tile) * 8 + get_tile_row(tile);
+  }
+  return tile;
+}
+
+// The symmetry that brings the white king, the first of tiles, to its part
+// of the board. With the king on the diagonal the first piece off it decides
+// whether to mirror along it, so every position has one index.
+unsigned get_symmetry(std::span<const int> tiles, bool has_pawns) {
+  unsigned symmetry{get_tile_column(tiles[0]) > 3 ? 1U : 0U};
+  if (has_pawns) {
+    return symmetry;
+  }
+  if (get_tile_row(tiles[0]) > 3) {
+    symmetry |= 2U;
+  }
+  for (const int tile : tiles) {
+    const int transformed{transform(tile, symmetry)};
+    const int row{get_tile_row(transformed)};
+    const int column{get_tile_column(transformed)};
+    if (row != column) {
+      return row > column ? symmetry | 4U : symmetry;
+    }
+  }
+  return symmetry;
+}
+
+uint64_t get_material_key(PieceColor color, PieceType type) {
+  return uint64_t{1} << (get_color_index(color) * 18U +
+                         (to_underlying(type) - 1U) * 3U);
+}
+
+uint64_t get_material_key(const Material& material, bool is_flipped) {
+  uint64_t key{};
+  for (int i = 0; i < material.count; i++) {
+    const Piece piece{material.pieces[static_cast<size_t>(i)]};
+    const PieceColor color{get_piece_color(piece)};
+    key += get_material_key(is_flipped ? get_opposite_color(color) : color,
+                            get_piece_type(piece));
+  }
+  return key;
+}
+
+uint64_t get_material_key(const Board& board) {
+  uint64_t key{};
+  for (const PieceColor color : {PieceColor::White, PieceColor::Black}) {
+    for (auto type = to_underlying(PieceType::King);
+         type <= to_underlying(PieceType::Pawn); type++) {
+      const auto piece_type{static_cast<PieceType>(type)};
+      key += static_cast<uint64_t>(
+                 std::popcount(board.get_bitboard(color, piece_type))) *
+             get_material_key(color, piece_type);
+    }
+  }
+  return key;
+}
+
+std::string to_name(const Material& material) {
+  std::string white{"K"};
+  std::string black{"K"};
+  for (int i = 2; i < material.count; i++) {
+    const Piece piece{material.pieces[static_cast<size_t>(i)]};
+    (get_piece_color(piece) == PieceColor::White ? white : black) +=
+        k_piece_letters[to_underlying(get_piece_type(piece)) - 1U];
+  }
+  return white + black;
+}
+
+void sort_pieces(Material& material) {
+  auto get_rank = [](Piece piece) {
+    return std::pair{get_piece_color(piece) == PieceColor::Black,
+                     std::find(k_piece_order.begin(), k_piece_order.end(),
+                               get_piece_type(piece)) -
+                         k_piece_order.begin()};
+  };
+  assert(2 <= material.count && material.count <= Tablebase::k_max_pieces);
+  const std::span pieces{std::span{material.pieces}.subspan(
+      2, static_cast<size_t>(material.count) - 2)};
+  std::sort(pieces.begin(), pieces.end(), [&](Piece left, Piece right) {
+    return get_rank(left) < get_rank(right);
+  });
+}
+
+// Sorts the pieces into name order and gives white the larger material, by
+// piece values and then by name.
+Material normalize(Material material) {
+  Material flipped{material};
+  std::swap(flipped.pieces[0], flipped.pieces[1]);
+  int value{};
+  for (int i = 0; i < material.count; i++) {
+    Piece& piece{flipped.pieces[static_cast<size_t>(i)]};
+    const PieceColor color{get_piece_color(piece)};
+    const PieceType type{get_piece_type(piece)};
+    value += (color == PieceColor::White ? 1 : -1) *
+             k_piece_weights[to_underlying(type)];
+    piece = make_piece(get_opposite_color(color), type);
+  }
+  sort_pieces(material);
+  sort_pieces(flipped);
+  return value < 0 || (value == 0 && to_name(flipped) < to_name(material))
+             ? flipped
+             : material;
+}
+
+std::optional<Material> parse_material(std::string_view name) {
+  Material material{.count = 2};
+  PieceColor color{PieceColor::None};
+  for (const char letter : name) {
+    const size_t type{k_piece_letters.find(letter)};
+    if (type == std::string_view::npos) {
+      return std::nullopt;
+    }
+    if (type == 0) {
+      if (color == PieceColor::Black) {
+        return std::nullopt;
+      }
+      color = color == PieceColor::None ? PieceColor::White : PieceColor::Black;
+      material.pieces[color == PieceColor::White ? 0 : 1] =
+          make_piece(color, PieceType::King);
+      continue;
+    }
+    if (color == PieceColor::None ||
+        material.count == Tablebase::k_max_pieces) {
+      return std::nullopt;
+    }
+    material.pieces[static_cast<size_t>(material.count++)] =
+        make_piece(color, static_cast<PieceType>(type + 1));
+  }
+  if (color != PieceColor::Black || material.count < 3) {
+    return std::nullopt;
+  }
+  return material;
+}
+
+// The materials one capture or promotion leads to, bare kings left out.
+std::vector<Material> get_exits(const Material& material) {
+  std::vector<Material> exits;
+  auto add = [&](Material exit, int removed) {
+    if (removed != -1) {
+      std::copy(exit.pieces.begin() + removed + 1,
+                exit.pieces.begin() + exit.count,
+                exit.pieces.begin() + removed);
+      exit.pieces[static_cast<size_t>(--exit.count)] = {};
+    }
+    if (exit.count > 2) {
+      exits.push_back(normalize(exit));
+    }
+  };
+  for (int i = 2; i < material.count; i++) {
+    add(material, i);
+    const Piece piece{material.pieces[static_cast<size_t>(i)]};
+    if (get_piece_type(piece) != PieceType::Pawn) {
+      continue;
+    }
+    for (const PieceType promotion : {PieceType::Queen, PieceType::Rook,
+                                      PieceType::Bishop, PieceType::Knight}) {
+      Material promoted{material};
+      promoted.pieces[static_cast<size_t>(i)] =
+          make_piece(get_piece_color(piece), promotion);
+      add(promoted, -1);
+      for (int j = 2; j < material.count; j++) {
+        if (get_piece_color(material.pieces[static_cast<size_t>(j)]) !=
+            get_piece_color(piece)) {
+          add(promoted, j);
+        }
+      }
+    }
+  }
+  return exits;
+}
+
+// Tiles a slider on tile reaches, the first occupied tile of each ray
+// included.
+Bitboard get_slider_tiles(int tile, Bitboard occupancy, bool is_straight,
+                          bool is_diagonal) {
+  static constexpr std::array<std::array<int, 2>, 8> k_directions{
+      {{0, 1}, {1, 0}, {0, -1}, {-1, 0}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}}};
+  Bitboard tiles{};
+  for (size_t i = 0; i < k_directions.size(); i++) {
+    if (!(i < 4 ? is_straight : is_diagonal)) {
+      continue;
+    }
+    int row{get_tile_row(tile) + k_directions[i][0]};
+    int column{get_tile_column(tile) + k_directions[i][1]};
+    for (; 0 <= row && row < 8 && 0 <= column && column < 8;
+         row += k_directions[i][0], column += k_directions[i][1]) {
+      const int target{row * 8 + column};
+      tiles |= make_bitboard(target);
+      if (has_tile(occupancy, target)) {
+        break;
+      }
+    }
+  }
+  return tiles;
+}
+}  // namespace
+
+Tablebase::Table::Table(const std::array<Piece, k_max_pieces>& new_pieces,
+                        int new_piece_count)
+    : pieces{new_pieces}, piece_count{new_piece_count} {
+  has_pawns = std::any_of(pieces.begin(), pieces.begin() + piece_count,
+                          [](Piece piece) {
+                            return get_piece_type(piece) == PieceType::Pawn;
+                          });
+  size = static_cast<size_t>(get_king_tiles(has_pawns).count);
+  for (int i = 1; i < piece_count; i++) {
+    size *= 64;
+  }
+}
+
+size_t Tablebase::Table::get_index(const Position& position) const {
+  const unsigned symmetry{get_symmetry(
+      std::span{position.tiles.data(), static_cast<size_t>(piece_count)},
+      has_pawns)};
+  auto index{static_cast<size_t>(
+      get_king_tiles(has_pawns).indices[static_cast<size_t>(
+          transform(position.tiles[0], symmetry))])};
+  for (int i = 1; i < piece_count; i++) {
+    index = index * 64 + static_cast<size_t>(transform(
+                             position.tiles[static_cast<size_t>(i)], symmetry));
+  }
+  return (position.turn == PieceColor::White ? 0 : size) + index;
+}
+
+Tablebase::Position Tablebase::Table::get_position(size_t index) const {
+  Position position{
+      .turn = index < size ? PieceColor::White : PieceColor::Black};
+  index %= size;
+  for (int i = piece_count - 1; i > 0; i--) {
+    position.tiles[static_cast<size_t>(i)] = static_cast<int>(index % 64);
+    index /= 64;
+  }
+  position.tiles[0] = get_king_tiles(has_pawns).tiles[index];
+  return position;
+}
+
+Tablebase::Position Tablebase::Table::get_position(const Board& board,
+                                                   bool is_flipped) const {
+  Position position{.turn = is_flipped
+                                ? get_opposite_color(board.get_turn())
+                                : board.get_turn()};
+  Bitboard used{};
+  for (int i = 0; i < piece_count; i++) {
+    const Piece piece{pieces[static_cast<size_t>(i)]};
+    const PieceColor color{get_piece_color(piece)};
+    Bitboard tiles{board.get_bitboard(
+                       is_flipped ? get_opposite_color(color) : color,
+                       get_piece_type(piece)) &
+                   ~used};
+    assert(tiles != 0);
+    const int tile{pop_tile(tiles)};
+    used |= make_bitboard(tile);
+    position.tiles[static_cast<size_t>(i)] = is_flipped ? tile ^ 56 : tile;
+  }
+  return position;
+}
+
+struct Tablebase::Generator {
+  enum class State : uint8_t { Unknown, Illegal, Loss, Draw, Win };
+
+  struct Update {
+    size_t index{};
+    State state{};
+    uint8_t plies{};
+  };
+
+  struct Worker {
+    Board board;
+    std::vector<Update> updates;
+  };
+
+  const Tablebase& tablebase;
+  const Table& table;
+  unsigned thread_count{};
+  std::vector<Worker> workers{};
+  std::vector<State> states{};
+  std::vector<uint8_t> plies{};
+  // Passes at which a capture or promotion can decide a win or a loss, 0
+  // for none.
+  std::vector<uint8_t> win_passes{};
+  std::vector<uint8_t> loss_passes{};
+  std::atomic<bool> has_overflow{};
+
+  // Calls body with every index, spread over the threads.
+  template <typename Body>
+  void for_each_index(Body body) {
+    std::atomic<size_t> next{};
+    std::vector<std::jthread> threads;
+    for (unsigned i = 0; i < thread_count; i++) {
+      threads.emplace_back([&, i] {
+        for (size_t begin = next.fetch_add(k_chunk_size); begin < states.size();
+             begin = next.fetch_add(k_chunk_size)) {
+          const size_t end{std::min(begin + k_chunk_size, states.size())};
+          for (size_t index = begin; index < end; index++) {
+            body(index, workers[i]);
+          }
+        }
+      });
+    }
+  }
+
+  bool run();
+  bool load_board(const Position& position, Board& board) const;
+  void initialize(size_t index, Board& board);
+  std::optional<Update> check(size_t index, int pass, Board& board) const;
+  template <typename Visit>
+  void for_each_predecessor(const Position& position, Visit visit) const;
+};
+
+// Builds the board of a position, false when no legal game reaches it.
+bool Tablebase::Generator::load_board(const Position& position,
+                                      Board& board) const {
+  Bitboard occupancy{};
+  for (int i = 0; i < table.piece_count; i++) {
+    const int tile{position.tiles[static_cast<size_t>(i)]};
+    const int row{get_tile_row(tile)};
+    if (has_tile(occupancy, tile) ||
+        (get_piece_type(table.pieces[static_cast<size_t>(i)]) ==
+             PieceType::Pawn &&
+         (row == 0 || row == 7))) {
+      return false;
+    }
+    occupancy |= make_bitboard(tile);
+  }
+
+  PackedPosition packed{
+      .occupancy = occupancy,
+      .state = static_cast<uint8_t>(position.turn == PieceColor::Black)};
+  Bitboard tiles{occupancy};
+  for (size_t i = 0; tiles != 0; i++) {
+    const int tile{pop_tile(tiles)};
+    const auto slot{static_cast<size_t>(
+        std::find(position.tiles.begin(), position.tiles.end(), tile) -
+        position.tiles.begin())};
+    const Piece piece{table.pieces[slot]};
+    const unsigned code{
+        to_underlying(get_piece_type(piece)) |
+        (get_piece_color(piece) == PieceColor::Black ? 8U : 0U)};
+    packed.pieces[i / 2] |= static_cast<uint8_t>(code << (4 * (i % 2)));
+  }
+  if (!board.load_packed(packed)) {
+    return false;
+  }
+
+  // The side that just moved must not have left its king in check.
+  return !board.is_threatened(
+      position.tiles[position.turn == PieceColor::White ? 1 : 0],
+      position.turn);
+}
+
+// Settles illegal and terminal positions and schedules the passes at which
+// captures and promotions, whose results are known, can settle the others.
+void Tablebase::Generator::initialize(size_t index, Board& board) {
+  // Some positions with the white king on the diagonal have a second index,
+  // which stays unused.
+  const Position position{table.get_position(index)};
+  if (table.get_index(position) != index || !load_board(position, board)) {
+    states[index] = State::Illegal;
+    return;
+  }
+  Moves moves;
+  board.generate_all_legal_moves(moves);
+  if (moves.size == 0) {
+    states[index] = board.is_in_check() ? State::Loss : State::Draw;
+    return;
+  }
+
+  std::optional<int> min_loss;
+  std::optional<int> max_win;
+  bool is_lost{true};
+  for (const PackedMove move : moves) {
+    if (!move.is_capture() && !move.is_promotion()) {
+      continue;
+    }
+    board.make_move(move);
+    const auto result{tablebase.probe(board)};
+    board.undo();
+    assert(result);
+    if (result->wdl == Wdl::Loss) {
+      min_loss = std::min(min_loss.value_or(k_max_plies), result->plies);
+      is_lost = false;
+    } else if (result->wdl == Wdl::Win) {
+      max_win = std::max(max_win.value_or(0), result->plies);
+    } else {
+      is_lost = false;
+    }
+  }
+
+  if (min_loss) {
+    win_passes[index] =
+        static_cast<uint8_t>(std::min(*min_loss + 1, k_max_plies));
+    has_overflow = has_overflow || *min_loss + 1 > k_max_plies;
+  }
+  if (is_lost && max_win) {
+    loss_passes[index] =
+        static_cast<uint8_t>(std::min(*max_win + 1, k_max_plies));
+    has_overflow = has_overflow || *max_win + 1 > k_max_plies;
+  }
+}
+
+// Looks at every move of an unsettled position with the results settled
+// before pass. It is won once a move leads to a loss and lost once every
+// move leads to a win.
+std::optional<Tablebase::Generator::Update> Tablebase::Generator::check(
+    size_t index, int pass, Board& board) const {
+  const Position position{table.get_position(index)};
+  [[maybe_unused]] const bool is_legal{load_board(position, board)};
+  assert(is_legal);
+  Moves moves;
+  board.generate_all_legal_moves(moves);
+
+  std::optional<int> min_loss;
+  int max_win{};
+  bool is_lost{true};
+  for (const PackedMove move : moves) {
+    std::optional<Result> result;
+    if (move.is_capture() || move.is_promotion()) {
+      board.make_move(move);
+      result = tablebase.probe(board);
+      board.undo();
+    } else {
+      // Quiet moves stay in the table, making them on the board would cost
+      // a status update.
+      Position child{position};
+      *std::find(child.tiles.begin(), child.tiles.end(), move.get_tile()) =
+          move.get_target();
+      child.turn = get_opposite_color(position.turn);
+      const size_t child_index{table.get_index(child)};
+      switch (states[child_index]) {
+        case State::Loss:
+          result = {Wdl::Loss, plies[child_index]};
+          break;
+        case State::Win:
+          result = {Wdl::Win, plies[child_index]};
+          break;
+        case State::Draw:
+          result = {Wdl::Draw, 0};
+          break;
+        default:
+          break;
+      }
+    }
+
+    if (!result || (result->wdl != Wdl::Draw && result->plies >= pass)) {
+      is_lost = false;
+    } else if (result->wdl == Wdl::Loss) {
+      min_loss = std::min(min_loss.value_or(k_max_plies), result->plies);
+    } else if (result->wdl == Wdl::Win) {
+      max_win = std::max(max_win, result->plies);
+    } else {
+      is_lost = false;
+    }
+  }
+
+  if (min_loss) {
+    return Update{index, State::Win, static_cast<uint8_t>(*min_loss + 1)};
+  }
+  if (is_lost) {
+    return Update{index, State::Loss, static_cast<uint8_t>(max_win + 1)};
+  }
+  return std::nullopt;
+}
+
+// Calls visit with the index of every position of the table with a quiet
+// move to position.
+template <typename Visit>
+void Tablebase::Generator::for_each_predecessor(const Position& position,
+                                                Visit visit) const {
+  const PieceColor mover{get_opposite_color(position.turn)};
+  Bitboard occupancy{};
+  for (int i = 0; i < table.piece_count; i++) {
+    occupancy |= make_bitboard(position.tiles[static_cast<size_t>(i)]);
+  }
+
+  for (int i = 0; i < table.piece_count; i++) {
+    const Piece piece{table.pieces[static_cast<size_t>(i)]};
+    if (get_piece_color(piece) != mover) {
+      continue;
+    }
+    const int tile{position.tiles[static_cast<size_t>(i)]};
+    const auto index{static_cast<size_t>(tile)};
+    Bitboard origins{};
+    switch (get_piece_type(piece)) {
+      case PieceType::King:
+        origins = k_king_attacks[index];
+        break;
+      case PieceType::Knight:
+        origins = k_knight_attacks[index];
+        break;
+      case PieceType::Queen:
+        origins = get_slider_tiles(tile, occupancy, true, true);
+        break;
+      case PieceType::Rook:
+        origins = get_slider_tiles(tile, occupancy, true, false);
+        break;
+      case PieceType::Bishop:
+        origins = get_slider_tiles(tile, occupancy, false, true);
+        break;
+      case PieceType::Pawn: {
+        const int forward{mover == PieceColor::White ? 8 : -8};
+        const int row{get_tile_row(tile - forward)};
+        // The tile behind is a pawn's first row at the latest.
+        if (row != 0 && row != 7 && !has_tile(occupancy, tile - forward)) {
+          origins = make_bitboard(tile - forward);
+          if (row == (mover == PieceColor::White ? 2 : 5)) {
+            origins |= make_bitboard(tile - 2 * forward);
+          }
+        }
+        break;
+      }
+      case PieceType::None:
+        assert(false);
+        break;
+    }
+
+    origins &= ~occupancy;
+    while (origins != 0) {
+      Position predecessor{position};
+      predecessor.tiles[static_cast<size_t>(i)] = pop_tile(origins);
+      predecessor.turn = mover;
+      visit(table.get_index(predecessor));
+    }
+  }
+}
+
+// Settles the positions one ply further from mate per pass. Pass n marks the
+// unsettled predecessors of the losses found in pass n - 1 as wins, and
+// checks those of the wins for losses. What is left at the end is drawn.
+bool Tablebase::Generator::run() {
+  const size_t count{table.size * 2};
+  workers.resize(thread_count);
+  states.assign(count, State::Unknown);
+  plies.assign(count, 0);
+  win_passes.assign(count, 0);
+  loss_passes.assign(count, 0);
+  for_each_index(
+      [&](size_t index, Worker& worker) { initialize(index, worker.board); });
+  if (has_overflow) {
+    return false;
+  }
+  const int last_scheduled_pass{std::max(
+      *std::max_element(win_passes.begin(), win_passes.end()),
+      *std::max_element(loss_passes.begin(), loss_passes.end()))};
+
+  for (int pass = 1;; pass++) {
+    if (pass > k_max_plies) {
+      return false;
+    }
+    for_each_index([&](size_t index, Worker& worker) {
+      const State state{states[index]};
+      if (state == State::Unknown) {
+        if (win_passes[index] == pass || loss_passes[index] == pass) {
+          if (const auto update = check(index, pass, worker.board)) {
+            worker.updates.push_back(*update);
+          }
+        }
+        return;
+      }
+      if ((state != State::Loss && state != State::Win) ||
+          plies[index] != pass - 1) {
+        return;
+      }
+      for_each_predecessor(table.get_position(index), [&](size_t predecessor) {
+        if (states[predecessor] != State::Unknown) {
+          return;
+        }
+        if (state == State::Loss) {
+          worker.updates.push_back(
+              {predecessor, State::Win, static_cast<uint8_t>(pass)});
+        } else if (const auto update = check(predecessor, pass, worker.board)) {
+          worker.updates.push_back(*update);
+        }
+      });
+    });
+
+    size_t settled{};
+    for (Worker& worker : workers) {
+      for (const Update& update : worker.updates) {
+        if (states[update.index] == State::Unknown) {
+          states[update.index] = update.state;
+          plies[update.index] = update.plies;
+          settled++;
+        }
+      }
+      worker.updates.clear();
+    }
+    if (settled == 0 && pass >= last_scheduled_pass) {
+      break;
+    }
+  }
+
+  std::replace(states.begin(), states.end(), State::Unknown, State::Draw);
+  return true;
+}
+
+size_t Tablebase::load(const std::filesystem::path& directory) {
+  size_t loaded{};
+  std::error_code error;
+  for (const auto& entry :
+       std::filesystem::directory_iterator{directory, error}) {
+    if (entry.path().extension() == k_extension && open(entry.path())) {
+      loaded++;
+    }
+  }
+  return loaded;
+}
+
+bool Tablebase::generate(std::string_view material,
+                         const std::filesystem::path& directory,
+                         unsigned thread_count) {
+  const auto parsed{parse_material(material)};
+  if (!parsed) {
+    LOGF("Tablebase", "{} is not a material of 3 to {} pieces", material,
+         k_max_pieces);
+    return false;
+  }
+  const Material normalized{normalize(*parsed)};
+  return generate(Table{normalized.pieces, normalized.count}, directory,
+                  std::max(thread_count, 1U));
+}
+
+bool Tablebase::generate(Table table, const std::filesystem::path& directory,
+                         unsigned thread_count) {
+  const Material material{table.pieces, table.piece_count};
+  if (find(get_material_key(material, false))) {
+    return true;
+  }
+  for (const Material& exit : get_exits(material)) {
+    if (!generate(Table{exit.pieces, exit.count}, directory, thread_count)) {
+      return false;
+    }
+  }
+
+  const std::string name{to_name(material)};
+  const auto start{std::chrono::high_resolution_clock::now()};
+  Generator generator{
+      .tablebase = *this, .table = table, .thread_count = thread_count};
+  if (!generator.run()) {
+    LOGF("Tablebase", "{} has mates longer than {} plies", name, k_max_plies);
+    return false;
+  }
+
+  using State = Generator::State;
+  const size_t count{generator.states.size()};
+  std::vector<uint8_t> wdl((count + 3) / 4);
+  std::array<size_t, 5> counts{};
+  for (size_t i = 0; i < count; i++) {
+    const State state{generator.states[i]};
+    counts[to_underlying(state)]++;
+    const unsigned code{state == State::Loss   ? 1U
+                        : state == State::Draw ? 2U
+                        : state == State::Win  ? 3U
+                                               : 0U};
+    wdl[i / 4] |= static_cast<uint8_t>(code << (i % 4 * 2));
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  std::filesystem::path path{directory / name};
+  path += k_extension;
+  {
+    const Header header{.magic = k_magic,
+                        .pieces = table.pieces,
+                        .piece_count = static_cast<uint32_t>(table.piece_count),
+                        .size = table.size};
+    std::ofstream file{path, std::ios::binary};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(wdl.data()),
+               static_cast<std::streamsize>(wdl.size()));
+    file.write(reinterpret_cast<const char*>(generator.plies.data()),
+               static_cast<std::streamsize>(count));
+    if (!file) {
+      LOGF("Tablebase", "Failed to write {}", path.string());
+      return false;
+    }
+  }
+
+  LOGF("Tablebase",
+       "{}: {} wins, {} draws, {} losses, {} illegal, longest mate {} plies, "
+       "{}ms",
+       name, counts[to_underlying(State::Win)],
+       counts[to_underlying(State::Draw)], counts[to_underlying(State::Loss)],
+       counts[to_underlying(State::Illegal)],
+       *std::max_element(generator.plies.begin(), generator.plies.end()),
+       std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::high_resolution_clock::now() - start)
+           .count());
+  return open(path);
+}
+
+bool Tablebase::open(const std::filesystem::path& path) {
+  MappedFile file{path};
+  const std::span<const std::byte> bytes{file.get_bytes()};
+  Header header;
+  if (bytes.size() >= sizeof(Header)) {
+    std::memcpy(&header, bytes.data(), sizeof(Header));
+  }
+  const auto parsed{parse_material(path.stem().string())};
+  if (header.magic != k_magic || !parsed ||
+      header.piece_count != static_cast<uint32_t>(parsed->count) ||
+      header.pieces != parsed->pieces) {
+    LOGF("Tablebase", "{} is not a tablebase file", path.string());
+    return false;
+  }
+  Table table{header.pieces, parsed->count};
+  const size_t count{table.size * 2};
+  if (header.size != table.size ||
+      bytes.size() != sizeof(Header) + (count + 3) / 4 + count) {
+    LOGF("Tablebase", "{} is not a tablebase file", path.string());
+    return false;
+  }
+  table.wdl = reinterpret_cast<const uint8_t*>(bytes.data() + sizeof(Header));
+  table.plies = table.wdl + (count + 3) / 4;
+  table.file = std::move(file);
+
+  const Material material{table.pieces, table.piece_count};
+  const Lookup lookup{.table = tables_.size()};
+  tables_.push_back(std::move(table));
+  lookups_.try_emplace(get_material_key(material, false), lookup);
+  lookups_.try_emplace(get_material_key(material, true),
+                       Lookup{.table = lookup.table, .is_flipped = true});
+  return true;
+}
+
+std::optional<Tablebase::Lookup> Tablebase::find(uint64_t material_key) const {
+  if (const auto it = lookups_.find(material_key); it != lookups_.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+std::optional<Tablebase::Result> Tablebase::probe(const Board& board) const {
+  const int count{std::popcount(board.get_bitboard(PieceColor::White) |
+                                board.get_bitboard(PieceColor::Black))};
+  if (count > k_max_pieces || board.has_castling_rights() ||
+      board.is_enpassant_possible()) {
+    return std::nullopt;
+  }
+  if (count == 2) {
+    return Result{.wdl = Wdl::Draw};
+  }
+  const auto lookup{find(get_material_key(board))};
+  if (!lookup) {
+    return std::nullopt;
+  }
+  const Table& table{tables_[lookup->table]};
+  const size_t index{
+      table.get_index(table.get_position(board, lookup->is_flipped))};
+  const unsigned code{static_cast<unsigned>(table.wdl[index / 4] >>
+                                            (index % 4 * 2)) &
+                      3U};
+  if (code == 0) {
+    return std::nullopt;
+  }
+  return Result{static_cast<Wdl>(code - 1), table.plies[index]};
+}
@@ -0,0 +1,280 @@
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "ai.hpp"
+#include "epd.hpp"
+#include "json.hpp"
+#include "san.hpp"
+
+namespace {
+// Finished results the workers may hold ahead of the writer, per thread.
+constexpr size_t k_reorder_window{16};
+
+struct Analysis {
+  std::string json;
+  bool has_error{};
+  // Set for records with bm or am operations.
+  std::optional<bool> is_solved;
+  std::chrono::milliseconds solution_time{};
+  uint64_t nodes{};
+  std::chrono::milliseconds time{};
+};
+
+// Hands analyses to the writer in input order. A worker waits while its
+// analysis is more than the window ahead of the next one to write, so the
+// worker holding the next one never waits.
+class ReorderBuffer {
+ public:
+  explicit ReorderBuffer(size_t window) : slots_(window) {}
+
+  void push(size_t index, Analysis analysis) {
+    {
+      std::unique_lock lock{mutex_};
+      condition_.wait(lock, [&] { return index < next_ + slots_.size(); });
+      slots_[index % slots_.size()] = std::move(analysis);
+    }
+    condition_.notify_all();
+  }
+
+  Analysis pop() {
+    Analysis analysis;
+    {
+      std::unique_lock lock{mutex_};
+      auto& slot{slots_[next_ % slots_.size()]};
+      condition_.wait(lock, [&] { return slot.has_value(); });
+      analysis = std::move(*slot);
+      slot.reset();
+      next_++;
+    }
+    condition_.notify_all();
+    return analysis;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::vector<std::optional<Analysis>> slots_;
+  size_t next_{};
+};
+
+// Whether the move is one of the space separated SAN moves.
+bool is_listed(Board& board, std::string_view moves, PackedMove move) {
+  std::istringstream stream{std::string{moves}};
+  std::string san;
+  while (stream >> san) {
+    if (parse_san(board, san) == move) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool is_solution(Board& board, const EpdRecord& record, PackedMove move) {
+  return (record.best_moves.empty() ||
+          is_listed(board, record.best_moves, move)) &&
+         (record.avoid_moves.empty() ||
+          !is_listed(board, record.avoid_moves, move));
+}
+
+Analysis analyze(AI& ai, const EpdRecord& record, size_t index,
+                 const SearchLimits& limits) {
+  Analysis analysis;
+  std::string json{std::format(R"({{"index":{},"id":"{}","fen":"{}")", index,
+                               escape_json(record.id),
+                               escape_json(record.fen))};
+  Board board;
+  if (const auto error = board.load_fen(record.fen)) {
+    analysis.has_error = true;
+    analysis.json = json + std::format(R"(,"error":"{} at {}"}})",
+                                       error->message, error->offset);
+    return analysis;
+  }
+  if (board.is_in_checkmate() || board.is_in_draw()) {
+    analysis.has_error = true;
+    analysis.json = json + R"(,"error":"No legal moves"})";
+    return analysis;
+  }
+
+  ai.clear();
+  ai.think(board, limits).wait();
+  const bool has_solution{!record.best_moves.empty() ||
+                          !record.avoid_moves.empty()};
+  std::optional<SearchProgress> last;
+  bool is_solved{};
+  std::chrono::milliseconds solution_time{};
+  while (const auto progress = ai.poll_progress()) {
+    if (progress->multi_pv != 1) {
+      continue;
+    }
+    // Solved from the first iteration after which the best move stays right.
+    const bool is_right{has_solution &&
+                        is_solution(board, record, progress->pv[0])};
+    if (is_right && !is_solved) {
+      solution_time = progress->time;
+    }
+    is_solved = is_right;
+    last = progress;
+  }
+  if (!last) {
+    analysis.has_error = true;
+    analysis.json = json + R"(,"error":"No completed iteration"})";
+    return analysis;
+  }
+
+  std::string pv;
+  for (size_t i = 0; i < static_cast<size_t>(last->pv_size); i++) {
+    pv += std::format(R"({}"{}")", i == 0 ? "" : ",",
+                      to_san(board, last->pv[i]));
+    board.make_move(last->pv[i]);
+  }
+  for (int i = 0; i < last->pv_size; i++) {
+    board.undo();
+  }
+
+  analysis.nodes = last->nodes;
+  analysis.time = last->time;
+  json += std::format(
+      R"(,"move":"{}","score":{},"depth":{},"nodes":{},"time_ms":{},"pv":[{}])",
+      to_san(board, last->pv[0]), last->score, last->depth, last->nodes,
+      last->time.count(), pv);
+  if (last->mate != 0) {
+    json += std::format(R"(,"mate":{})", last->mate);
+  }
+  if (has_solution) {
+    analysis.is_solved = is_solved;
+    json += std::format(R"(,"solved":{})", is_solved);
+    if (is_solved) {
+      analysis.solution_time = solution_time;
+      json += std::format(R"(,"solution_ms":{})", solution_time.count());
+    }
+  }
+  analysis.json = json + "}";
+  return analysis;
+}
+}  // namespace
+
+// Analyzes every position of an EPD or FEN file on a pool of AIs and writes
+// one JSON line per position in input order. Positions with bm or am
+// operations are scored as a test suite, solved once the best move stays
+// right, and the summary reports the solved count and times. With --mate the
+// mate solver gets the first try at every position, with --tablebases the
+// endings in the tables are scored by them.
+int main(int argc, char* argv[]) {
+  SearchLimits limits;
+  std::optional<int> time_ms;
+  bool has_depth{};
+  unsigned thread_count{std::max(std::thread::hardware_concurrency(), 1U)};
+  std::string output_path;
+  std::shared_ptr<Tablebase> tablebase;
+  bool is_valid{argc % 2 == 0};
+  for (int i = 1; is_valid && i + 1 < argc; i += 2) {
+    const std::string_view arg{argv[i]};
+    const std::string_view value{argv[i + 1]};
+    const char* last{value.data() + value.size()};
+    auto parse = [&](auto& number) {
+      return std::from_chars(value.data(), last, number).ec == std::errc{} &&
+             number > 0;
+    };
+    if (arg == "--depth") {
+      has_depth = true;
+      is_valid = parse(limits.depth) &&
+                 limits.depth < SearchProgress::k_max_pv_size;
+    } else if (arg == "--nodes") {
+      limits.nodes = 0;
+      is_valid = parse(*limits.nodes);
+    } else if (arg == "--time") {
+      time_ms = 0;
+      is_valid = parse(*time_ms);
+    } else if (arg == "--mate") {
+      is_valid = parse(limits.mate_threads);
+    } else if (arg == "--threads") {
+      is_valid = parse(thread_count);
+    } else if (arg == "--output") {
+      output_path = value;
+    } else if (arg == "--tablebases") {
+      tablebase = std::make_shared<Tablebase>();
+      is_valid = tablebase->load(value) != 0;
+    } else {
+      is_valid = false;
+    }
+  }
+  if (!is_valid) {
+    std::cerr << "usage: chess-analyze [--depth N] [--nodes N] [--time MS] "
+                 "[--mate THREADS] [--threads N] [--output FILE] "
+                 "[--tablebases DIR] POSITIONS\n";
+    return 1;
+  }
+  // Without any limit positions get the default time.
+  if (time_ms) {
+    limits.time = std::chrono::milliseconds{*time_ms};
+  } else if (has_depth || limits.nodes) {
+    limits.time.reset();
+  }
+
+  EpdReader reader{argv[argc - 1]};
+  if (!reader.is_open()) {
+    std::cerr << std::format("Failed to read {}\n", argv[argc - 1]);
+    return 1;
+  }
+  std::vector<EpdRecord> records;
+  while (const auto record = reader.next()) {
+    records.push_back(*record);
+  }
+
+  std::ofstream file;
+  if (!output_path.empty()) {
+    file.open(output_path);
+    if (!file) {
+      std::cerr << std::format("Failed to open {}\n", output_path);
+      return 1;
+    }
+  }
+  std::ostream& output{output_path.empty() ? std::cout : file};
+
+  ReorderBuffer buffer{k_reorder_window * thread_count};
+  std::atomic<size_t> next_record{};
+  std::vector<std::jthread> threads;
+  for (unsigned i = 0; i < thread_count; i++) {
+    threads.emplace_back([&] {
+      AI ai;
+      ai.set_tablebase(tablebase);
+      for (size_t index = next_record++; index < records.size();
+           index = next_record++) {
+        buffer.push(index, analyze(ai, records[index], index + 1, limits));
+      }
+    });
+  }
+
+  size_t errors{};
+  size_t tests{};
+  size_t solved{};
+  uint64_t nodes{};
+  std::chrono::milliseconds time{};
+  std::chrono::milliseconds solution_time{};
+  for (size_t i = 0; i < records.size(); i++) {
+    const Analysis analysis{buffer.pop()};
+    output << analysis.json << '\n';
+    errors += analysis.has_error ? size_t{1} : size_t{0};
+    tests += analysis.is_solved ? size_t{1} : size_t{0};
+    solved += analysis.is_solved.value_or(false) ? size_t{1} : size_t{0};
+    nodes += analysis.nodes;
+    time += analysis.time;
+    solution_time += analysis.solution_time;
+  }
+  output.flush();
+
+  std::cerr << std::format("Positions: {}, errors: {}\n", records.size(),
+                           errors);
+  if (tests != 0) {
+    std::cerr << std::format(
+        "Solved: {}/{} ({:.1f}%), mean time to solution: {}ms\n", solved,
+        tests, 100.0 * static_cast<double>(solved) / static_cast<double>(tests),
+        solved == 0 ? 0 : solution_time.count() / static_cast<int64_t>(solved));
+  }
+  std::cerr << std::format(
+      "Nodes: {}, search time: {}ms, NPS: {}\n", nodes, time.count(),
+      nodes * 1000 / static_cast<uint64_t>(time.count() + 1));
+  return output ? 0 : 1;
+}
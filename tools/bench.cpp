@@ -0,0 +1,49 @@
+#include <charconv>
+#include <iostream>
+
+#include "ai.hpp"
+#include "positions.hpp"
+
+namespace {
+constexpr int k_default_depth{5};
+}  // namespace
+
+// Searches every position to a fixed depth with a cleared table. The total
+// node count is a signature of the search, a change that only makes the
+// engine faster must not change it.
+int main(int argc, char* argv[]) {
+  int depth{k_default_depth};
+  if (argc > 1) {
+    const std::string_view arg{argv[1]};
+    if (std::from_chars(arg.data(), arg.data() + arg.size(), depth).ec !=
+            std::errc{} ||
+        depth < 1) {
+      std::cerr << "usage: chess-bench [depth]\n";
+      return 1;
+    }
+  }
+
+  const SearchLimits limits{
+      .depth = depth, .time = std::nullopt, .nodes = std::nullopt};
+  AI ai;
+  Board board;
+  uint64_t total_nodes{};
+  std::chrono::nanoseconds total_time{};
+  for (size_t i = 0; i < k_bench_positions.size(); i++) {
+    board.load_fen(k_bench_positions[i]);
+    ai.clear();
+    const auto start{std::chrono::high_resolution_clock::now()};
+    const Move move{ai.think(board, limits).get()};
+    total_time += std::chrono::high_resolution_clock::now() - start;
+    total_nodes += ai.get_nodes();
+    std::cout << std::format("Position {:>2}: {} {} nodes\n", i + 1,
+                             to_string(move), ai.get_nodes());
+  }
+
+  const auto time{
+      std::chrono::duration_cast<std::chrono::milliseconds>(total_time)};
+  std::cout << std::format(
+      "\nNodes: {}\nTime: {}ms\nNPS: {}\n", total_nodes, time.count(),
+      total_nodes * 1000 / static_cast<uint64_t>(time.count() + 1));
+  return 0;
+}
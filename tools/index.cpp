@@ -0,0 +1,71 @@
+#include <iostream>
+
+#include "position_index.hpp"
+#include "san.hpp"
+
+namespace {
+constexpr size_t k_max_listed_games{10};
+
+int query(const std::filesystem::path& index_path, std::string_view fen) {
+  const PositionIndex index{index_path};
+  if (!index.is_open()) {
+    return 1;
+  }
+  Board board;
+  if (const auto error = board.load_fen(fen)) {
+    std::cerr << std::format("Invalid FEN at {}: {}\n", error->offset,
+                             error->message);
+    return 1;
+  }
+
+  const auto start{std::chrono::high_resolution_clock::now()};
+  const auto moves{index.find_moves(board.get_key())};
+  const auto games{index.find_games(board.get_key())};
+  const std::chrono::duration<double, std::micro> time{
+      std::chrono::high_resolution_clock::now() - start};
+
+  std::vector<PositionMoveStats> sorted_moves{moves.begin(), moves.end()};
+  std::sort(sorted_moves.begin(), sorted_moves.end(),
+            [](const auto& left, const auto& right) {
+              return left.count > right.count;
+            });
+  for (const PositionMoveStats& stats : sorted_moves) {
+    const double count{static_cast<double>(stats.count)};
+    std::cout << std::format(
+        "{:<8}{:>10}{:>8.1f}%{:>8.1f}%{:>8.1f}%\n",
+        stats.move.is_null() ? "(end)" : to_san(board, stats.move),
+        stats.count, 100.0 * stats.white_wins / count,
+        100.0 * stats.draws / count, 100.0 * stats.black_wins / count);
+  }
+
+  std::cout << std::format("Games: {}", games.size());
+  for (size_t i = 0; i < std::min(games.size(), k_max_listed_games); i++) {
+    std::cout << std::format(" {}", games[i].game);
+  }
+  std::cout << std::format("\nLookup: {:.1f}us\n", time.count());
+  return 0;
+}
+}  // namespace
+
+// chess-index build GAMES.pgn INDEX builds an index of every position in
+// the games, chess-index query INDEX FEN lists the moves played from a
+// position with their results and the games that reached it.
+int main(int argc, char* argv[]) {
+  const std::string_view command{argc > 1 ? argv[1] : ""};
+  if (argc == 4 && command == "build") {
+    const auto start{std::chrono::high_resolution_clock::now()};
+    if (!build_position_index(argv[2], argv[3])) {
+      return 1;
+    }
+    const auto time{std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start)};
+    std::cout << std::format("Built {} in {}ms\n", argv[3], time.count());
+    return 0;
+  }
+  if (argc == 4 && command == "query") {
+    return query(argv[2], argv[3]);
+  }
+  std::cerr << "usage: chess-index build GAMES.pgn INDEX\n"
+               "       chess-index query INDEX FEN\n";
+  return 1;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <format>
+#include <string>
+#include <string_view>
+
+// Escapes text for a JSON string, control characters as \u00XX.
+inline std::string escape_json(std::string_view text) {
+  std::string escaped;
+  for (const char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      escaped += std::format("\\u{:04x}", static_cast<unsigned char>(c));
+      continue;
+    }
+    escaped += c;
+  }
+  return escaped;
+}
@@ -0,0 +1,136 @@
+#include <charconv>
+#include <iostream>
+
+#include "mcts.hpp"
+#include "positions.hpp"
+
+namespace {
+constexpr uint64_t k_default_time_ms{100};
+// Games longer than this are drawn.
+constexpr int k_max_plies{200};
+// Size of a shared hash this process creates.
+constexpr size_t k_shared_hash_mb{64};
+
+struct Totals {
+  int wins{};
+  int draws{};
+  int losses{};
+  uint64_t playouts{};
+  std::chrono::milliseconds time{};
+};
+
+// Plays one game from fen, returns 1 when MCTS won, -1 when alpha-beta did.
+int play_game(AI& ai, MctsAI& mcts, std::string_view fen, bool is_mcts_white,
+              const SearchLimits& limits, Totals& totals) {
+  Board board;
+  board.load_fen(fen);
+  ai.clear();
+  mcts.clear();
+  for (int ply = 0; ply < k_max_plies; ply++) {
+    if (board.is_in_checkmate()) {
+      const bool is_mcts_turn{(board.get_turn() == PieceColor::White) ==
+                              is_mcts_white};
+      return is_mcts_turn ? -1 : 1;
+    }
+    if (board.is_in_draw()) {
+      return 0;
+    }
+
+    const bool is_mcts_turn{(board.get_turn() == PieceColor::White) ==
+                            is_mcts_white};
+    Move move;
+    if (is_mcts_turn) {
+      move = mcts.think(board, limits).get();
+      // The last progress is published when the search ends.
+      std::chrono::milliseconds time{};
+      while (const auto progress = mcts.poll_progress()) {
+        time = progress->time;
+      }
+      totals.playouts += mcts.get_nodes();
+      totals.time += time;
+    } else {
+      move = ai.think(board, limits).get();
+      while (ai.poll_progress()) {
+      }
+    }
+    board.play_move(move);
+  }
+  return 0;
+}
+}  // namespace
+
+// Plays the alpha-beta AI against the MCTS backend from every bench position
+// with both colors, at a fixed time per move. The playout rate shows how
+// MCTS scales with its thread count. --shared-hash gives the alpha-beta AI the
+// transposition table in the named shared memory, as with chess-server.
+int main(int argc, char* argv[]) {
+  uint64_t time_ms{k_default_time_ms};
+  size_t positions{k_bench_positions.size()};
+  MctsOptions options;
+  std::string shared_name;
+  bool is_valid{argc % 2 == 1};
+  for (int i = 1; is_valid && i + 1 < argc; i += 2) {
+    const std::string_view arg{argv[i]};
+    const std::string_view value{argv[i + 1]};
+    const char* last{value.data() + value.size()};
+    auto parse = [&](auto& number) {
+      return std::from_chars(value.data(), last, number).ec == std::errc{} &&
+             number != 0;
+    };
+    if (arg == "--time") {
+      is_valid = parse(time_ms);
+    } else if (arg == "--positions") {
+      is_valid = parse(positions) && positions <= k_bench_positions.size();
+    } else if (arg == "--threads") {
+      is_valid = parse(options.threads);
+    } else if (arg == "--tree") {
+      is_valid = parse(options.tree_mb);
+    } else if (arg == "--playout-plies") {
+      is_valid = std::from_chars(value.data(), last, options.playout_plies)
+                         .ec == std::errc{} &&
+                 options.playout_plies >= 0 &&
+                 options.playout_plies <= MctsAI::k_max_plies;
+    } else if (arg == "--shared-hash") {
+      shared_name = value;
+    } else {
+      is_valid = false;
+    }
+  }
+  if (!is_valid) {
+    std::cerr << "usage: chess-match [--time MS] [--positions N] [--threads N] "
+                 "[--tree MB] [--playout-plies N] [--shared-hash NAME]\n";
+    return 1;
+  }
+
+  const SearchLimits limits{.time = std::chrono::milliseconds{time_ms},
+                            .nodes = std::nullopt};
+  const auto table{shared_name.empty()
+                       ? std::make_shared<TranspositionTable>()
+                       : std::make_shared<TranspositionTable>(
+                             shared_name, k_shared_hash_mb)};
+  if (!shared_name.empty() && !table->is_shared()) {
+    std::cerr << std::format("Failed to open shared hash {}\n", shared_name);
+    return 1;
+  }
+  AI ai{table};
+  MctsAI mcts{options};
+  Totals totals;
+  for (size_t i = 0; i < positions; i++) {
+    for (const bool is_mcts_white : {true, false}) {
+      const int result{play_game(ai, mcts, k_bench_positions[i], is_mcts_white,
+                                 limits, totals)};
+      (result > 0 ? totals.wins : result < 0 ? totals.losses : totals.draws)++;
+      std::cout << std::format("Position {:>2} MCTS {}: {}\n", i + 1,
+                               is_mcts_white ? "white" : "black",
+                               result > 0   ? "win"
+                               : result < 0 ? "loss"
+                                            : "draw");
+    }
+  }
+
+  std::cout << std::format(
+      "\nMCTS wins {}, draws {}, losses {}\nPlayouts/s: {}\n", totals.wins,
+      totals.draws, totals.losses,
+      totals.playouts * 1000 / static_cast<uint64_t>(totals.time.count() + 1));
+  return 0;
+}
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "ai.hpp"
+#include "positions.hpp"
+
+namespace {
+constexpr int k_warmup_samples{20};
+constexpr int k_samples{200};
+constexpr double k_default_threshold{5.0};
+
+struct Result {
+  std::string_view name;
+  double median_ns{};
+  // 99th percentile of the per-operation means of the batches, batching
+  // averages out the tail of single operations.
+  double batch_p99_ns{};
+};
+
+// Keeps the benchmarked work from being optimized away.
+volatile uint64_t g_sink;
+
+// Runs batch, which returns how many operations it did, repeatedly and
+// reports the time per operation.
+template <typename Batch>
+Result measure(std::string_view name, Batch batch) {
+  for (int i = 0; i < k_warmup_samples; i++) {
+    batch();
+  }
+
+  std::vector<double> samples;
+  samples.reserve(k_samples);
+  for (int i = 0; i < k_samples; i++) {
+    const auto start{std::chrono::high_resolution_clock::now()};
+    const uint64_t operations{batch()};
+    const std::chrono::duration<double, std::nano> time{
+        std::chrono::high_resolution_clock::now() - start};
+    samples.push_back(time.count() / static_cast<double>(operations));
+  }
+  std::sort(samples.begin(), samples.end());
+  return {name, samples[samples.size() / 2],
+          samples[samples.size() * 99 / 100]};
+}
+
+// Compares is_legal with the move generator on every tile pair and promotion
+// in the positions and the positions one move after them, printing each
+// disagreement. Returns how many there were.
+size_t check_is_legal(std::vector<Board>& boards) {
+  constexpr std::array k_promotions{PieceType::None, PieceType::Queen,
+                                    PieceType::Rook, PieceType::Bishop,
+                                    PieceType::Knight};
+  size_t mismatches{};
+  auto check = [&](Board& board) {
+    Moves generated;
+    board.generate_all_legal_moves(generated);
+    // Bit promotion of tile * 64 + target is set for generated moves.
+    std::array<uint8_t, 64 * 64> is_generated{};
+    for (const PackedMove move : generated) {
+      is_generated[static_cast<size_t>(move.get_tile() * 64 +
+                                       move.get_target())] |=
+          static_cast<uint8_t>(1U << to_underlying(move.get_promotion()));
+    }
+    for (int tile = 0; tile < 64; tile++) {
+      for (int target = 0; target < 64; target++) {
+        const unsigned promotions{
+            is_generated[static_cast<size_t>(tile * 64 + target)]};
+        for (const PieceType promotion : k_promotions) {
+          const Move move{tile, target, promotion};
+          const bool is_expected{
+              (promotions >> to_underlying(promotion) & 1U) != 0};
+          if (board.is_legal(move) != is_expected) {
+            std::cerr << std::format(
+                "is_legal disagrees with the generator on {} in {}\n",
+                to_string(move), board.to_fen());
+            mismatches++;
+          }
+        }
+      }
+    }
+  };
+  for (Board& board : boards) {
+    check(board);
+    Moves moves;
+    board.generate_all_legal_moves(moves);
+    for (const PackedMove move : moves) {
+      board.make_move(move);
+      check(board);
+      board.undo();
+    }
+  }
+  return mismatches;
+}
+
+std::string to_json(const std::vector<Result>& results) {
+  std::string json{"{\n"};
+  for (size_t i = 0; i < results.size(); i++) {
+    json += std::format(
+        R"(  "{}": {{"median_ns": {:.3f}, "batch_p99_ns": {:.3f}}})",
+        results[i].name, results[i].median_ns, results[i].batch_p99_ns);
+    json += i + 1 == results.size() ? "\n" : ",\n";
+  }
+  json += "}\n";
+  return json;
+}
+
+// Reads a median back from JSON written by to_json.
+std::optional<double> find_median(std::string_view json,
+                                  std::string_view name) {
+  constexpr std::string_view k_median_key{"\"median_ns\": "};
+  size_t position{json.find(std::format("\"{}\"", name))};
+  if (position == std::string_view::npos) {
+    return std::nullopt;
+  }
+  position = json.find(k_median_key, position);
+  if (position == std::string_view::npos) {
+    return std::nullopt;
+  }
+  position += k_median_key.size();
+  double median{};
+  if (std::from_chars(json.data() + position, json.data() + json.size(), median)
+          .ec != std::errc{}) {
+    return std::nullopt;
+  }
+  return median;
+}
+
+std::optional<std::string> read_file(const std::string& path) {
+  std::ifstream file{path};
+  if (!file) {
+    return std::nullopt;
+  }
+  std::stringstream stream;
+  stream << file.rdbuf();
+  return stream.str();
+}
+}  // namespace
+
+// Times the board and evaluation kernels in isolation over the bench
+// positions. With --baseline the medians are compared against an earlier
+// --json output and the exit code is 1 when one got slower than the
+// threshold in percent.
+int main(int argc, char* argv[]) {
+  std::string json_path;
+  std::string baseline_path;
+  double threshold{k_default_threshold};
+  bool is_valid{argc % 2 == 1};
+  for (int i = 1; is_valid && i + 1 < argc; i += 2) {
+    const std::string_view arg{argv[i]};
+    const std::string_view value{argv[i + 1]};
+    if (arg == "--json") {
+      json_path = value;
+    } else if (arg == "--baseline") {
+      baseline_path = value;
+    } else if (arg == "--threshold") {
+      is_valid = std::from_chars(value.data(), value.data() + value.size(),
+                                 threshold)
+                     .ec == std::errc{};
+    } else {
+      is_valid = false;
+    }
+  }
+  if (!is_valid) {
+    std::cerr << "usage: chess-microbench [--json FILE] [--baseline FILE] "
+                 "[--threshold PERCENT]\n";
+    return 1;
+  }
+
+  std::vector<Board> boards(k_bench_positions.size());
+  std::vector<Moves> moves(k_bench_positions.size());
+  for (size_t i = 0; i < k_bench_positions.size(); i++) {
+    boards[i].load_fen(k_bench_positions[i]);
+    boards[i].generate_all_legal_moves(moves[i]);
+  }
+  if (const size_t mismatches = check_is_legal(boards); mismatches != 0) {
+    std::cerr << std::format("is_legal failed on {} moves\n", mismatches);
+    return 1;
+  }
+
+  std::vector<Result> results;
+  results.push_back(measure("make_move+undo", [&] {
+    uint64_t operations{};
+    for (size_t i = 0; i < boards.size(); i++) {
+      for (const PackedMove move : moves[i]) {
+        boards[i].make_move(move);
+        g_sink = g_sink + boards[i].get_key();
+        boards[i].undo();
+        operations++;
+      }
+    }
+    return operations;
+  }));
+  results.push_back(measure("generate_all_legal_moves", [&] {
+    for (Board& board : boards) {
+      Moves generated;
+      board.generate_all_legal_moves(generated);
+      g_sink = g_sink + static_cast<uint64_t>(generated.size);
+    }
+    return boards.size();
+  }));
+  results.push_back(measure("is_legal", [&] {
+    uint64_t operations{};
+    for (size_t i = 0; i < boards.size(); i++) {
+      for (const PackedMove move : moves[i]) {
+        g_sink = g_sink + (boards[i].is_legal(move) ? 1 : 0);
+        operations++;
+      }
+    }
+    return operations;
+  }));
+  results.push_back(measure("is_threatened", [&] {
+    for (const Board& board : boards) {
+      for (int tile = 0; tile < 64; tile++) {
+        const bool is_white_threat{
+            board.is_threatened(tile, PieceColor::White)};
+        const bool is_black_threat{
+            board.is_threatened(tile, PieceColor::Black)};
+        g_sink = g_sink + (is_white_threat ? 1 : 0) + (is_black_threat ? 1 : 0);
+      }
+    }
+    return boards.size() * 64 * 2;
+  }));
+  results.push_back(measure("evaluate", [&] {
+    for (const Board& board : boards) {
+      g_sink = g_sink + static_cast<uint64_t>(AI::evaluate(board));
+    }
+    return boards.size();
+  }));
+  // Includes copying the unordered moves.
+  results.push_back(measure("order_moves", [&] {
+    for (size_t i = 0; i < boards.size(); i++) {
+      Moves ordered{moves[i]};
+      AI::order_moves(boards[i], ordered);
+      g_sink = g_sink + ordered.data[0].get_data();
+    }
+    return boards.size();
+  }));
+
+  std::optional<std::string> baseline;
+  if (!baseline_path.empty()) {
+    baseline = read_file(baseline_path);
+    if (!baseline) {
+      std::cerr << std::format("Failed to read {}\n", baseline_path);
+      return 1;
+    }
+  }
+
+  bool has_regression{};
+  std::cout << std::format("{:<26}{:>12}{:>14}{:>12}\n", "Kernel",
+                           "Median ns", "Batch P99 ns", "Change");
+  for (const Result& result : results) {
+    std::string change;
+    if (baseline) {
+      if (const auto median = find_median(*baseline, result.name)) {
+        const double percent{(result.median_ns / *median - 1.0) * 100.0};
+        change = std::format("{:+.1f}%", percent);
+        if (percent > threshold) {
+          change += " REGRESSION";
+          has_regression = true;
+        }
+      }
+    }
+    std::cout << std::format("{:<26}{:>12.1f}{:>14.1f}{:>12}\n", result.name,
+                             result.median_ns, result.batch_p99_ns, change);
+  }
+
+  if (!json_path.empty()) {
+    std::ofstream file{json_path};
+    file << to_json(results);
+    if (!file) {
+      std::cerr << std::format("Failed to write {}\n", json_path);
+      return 1;
+    }
+  }
+  return has_regression ? 1 : 0;
+}
@@ -0,0 +1,194 @@
+#include <charconv>
+#include <iostream>
+#include <random>
+
+#include "ai.hpp"
+#include "bounded_queue.hpp"
+#include "packed_position_file.hpp"
+
+namespace {
+constexpr size_t k_default_games{1000};
+constexpr uint64_t k_default_nodes{5000};
+constexpr uint64_t k_default_seed{1};
+constexpr uint64_t k_seed_stride{0x9e3779b97f4a7c15};
+constexpr int k_min_random_plies{6};
+constexpr int k_max_random_plies{12};
+// Games longer than this are drawn.
+constexpr int k_max_plies{300};
+// Games where the score stays beyond k_win_score for k_win_plies in a row
+// are won.
+constexpr int k_win_score{1500};
+constexpr int k_win_plies{8};
+constexpr size_t k_queue_capacity{256};
+constexpr size_t k_seen_keys{size_t{1} << 24U};
+constexpr size_t k_report_games{100};
+
+struct Sample {
+  uint64_t key{};
+  PackedPosition position;
+};
+
+bool is_tactical(const Board& board, Move move) {
+  return move.promotion != PieceType::None || !board.is_empty(move.target) ||
+         (board.get_type(move.tile) == PieceType::Pawn &&
+          get_tile_column(move.tile) != get_tile_column(move.target));
+}
+
+bool is_game_over(const Board& board) {
+  return board.is_in_checkmate() || board.is_in_draw();
+}
+
+// Plays a game from random opening moves, ai searching every move to nodes.
+// Returns the quiet positions labelled with the search score and the result,
+// both from white's point of view.
+std::vector<Sample> play_game(AI& ai, uint64_t nodes, std::mt19937_64& random) {
+  Board board;
+  const int random_plies{std::uniform_int_distribution{
+      k_min_random_plies, k_max_random_plies}(random)};
+  for (int ply = 0; ply < random_plies && !is_game_over(board); ply++) {
+    Moves moves;
+    board.generate_all_legal_moves(moves);
+    board.play_move(moves.data[static_cast<size_t>(
+        std::uniform_int_distribution{0, moves.size - 1}(random))]);
+  }
+
+  ai.clear();
+  std::vector<Sample> samples;
+  int result{};
+  int win_plies{};
+  for (int ply = 0;; ply++) {
+    if (board.is_in_checkmate()) {
+      result = board.get_turn() == PieceColor::White ? -1 : 1;
+      break;
+    }
+    if (board.is_in_draw() || ply == k_max_plies) {
+      break;
+    }
+
+    const Move move{
+        ai.think(board, {.time = std::nullopt, .nodes = nodes}).get()};
+    int score{};
+    while (const auto progress = ai.poll_progress()) {
+      if (progress->multi_pv == 1) {
+        score = progress->score;
+      }
+    }
+    if (board.get_turn() == PieceColor::Black) {
+      score = -score;
+    }
+
+    win_plies = score >= k_win_score    ? std::max(win_plies, 0) + 1
+                : score <= -k_win_score ? std::min(win_plies, 0) - 1
+                                        : 0;
+    if (std::abs(win_plies) == k_win_plies) {
+      result = win_plies > 0 ? 1 : -1;
+      break;
+    }
+
+    if (!board.is_in_check() && !is_tactical(board, move) &&
+        std::abs(score) < AI::k_mate_threshold) {
+      if (const auto packed = board.to_packed()) {
+        Sample& sample{samples.emplace_back(board.get_key(), *packed)};
+        sample.position.score = static_cast<int16_t>(
+            std::clamp<int>(score, std::numeric_limits<int16_t>::min(),
+                            std::numeric_limits<int16_t>::max()));
+      }
+    }
+    board.play_move(move);
+  }
+
+  for (Sample& sample : samples) {
+    sample.position.result = static_cast<int8_t>(result);
+  }
+  return samples;
+}
+}  // namespace
+
+// Plays games on every thread and writes their quiet positions as packed
+// positions. Each game is seeded from the seed and its number, so a run is
+// repeatable apart from the order of the games in the file.
+int main(int argc, char* argv[]) {
+  size_t games{k_default_games};
+  uint64_t nodes{k_default_nodes};
+  uint64_t seed{k_default_seed};
+  unsigned thread_count{std::max(std::thread::hardware_concurrency(), 1U)};
+  bool is_valid{argc % 2 == 0};
+  for (int i = 1; is_valid && i + 1 < argc; i += 2) {
+    const std::string_view arg{argv[i]};
+    const std::string_view value{argv[i + 1]};
+    const char* last{value.data() + value.size()};
+    auto parse = [&](auto& number) {
+      return std::from_chars(value.data(), last, number).ec == std::errc{} &&
+             number != 0;
+    };
+    if (arg == "--games") {
+      is_valid = parse(games);
+    } else if (arg == "--nodes") {
+      is_valid = parse(nodes);
+    } else if (arg == "--threads") {
+      is_valid = parse(thread_count);
+    } else if (arg == "--seed") {
+      is_valid = std::from_chars(value.data(), last, seed).ec == std::errc{};
+    } else {
+      is_valid = false;
+    }
+  }
+  if (!is_valid) {
+    std::cerr << "usage: chess-selfplay [--games N] [--nodes N] [--threads N] "
+                 "[--seed N] OUTPUT\n";
+    return 1;
+  }
+
+  PackedPositionWriter writer{argv[argc - 1]};
+  if (!writer.is_open()) {
+    std::cerr << std::format("Failed to open {}\n", argv[argc - 1]);
+    return 1;
+  }
+
+  // The writer drops positions whose key it saw before. Like the
+  // transposition table it remembers one key per slot, so a duplicate whose
+  // slot was taken over passes again.
+  BoundedQueue<std::vector<Sample>> queue{k_queue_capacity};
+  const auto start{std::chrono::high_resolution_clock::now()};
+  std::jthread writer_thread{[&] {
+    std::vector<uint64_t> seen_keys(k_seen_keys);
+    size_t written_games{};
+    size_t duplicates{};
+    while (const auto samples = queue.pop()) {
+      for (const Sample& sample : *samples) {
+        uint64_t& seen_key{seen_keys[sample.key & (k_seen_keys - 1)]};
+        if (seen_key == sample.key) {
+          duplicates++;
+          continue;
+        }
+        seen_key = sample.key;
+        writer.write(sample.position);
+      }
+      if (++written_games % k_report_games == 0 || written_games == games) {
+        const auto time{std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - start)};
+        std::cout << std::format(
+            "Games {}/{}, positions {}, duplicates {}, {} positions/s\n",
+            written_games, games, writer.size(), duplicates,
+            writer.size() * 1000 / static_cast<size_t>(time.count() + 1));
+      }
+    }
+    writer.close();
+  }};
+
+  std::atomic<size_t> next_game{};
+  {
+    std::vector<std::jthread> threads;
+    for (unsigned i = 0; i < thread_count; i++) {
+      threads.emplace_back([&] {
+        AI ai;
+        for (size_t game = next_game++; game < games; game = next_game++) {
+          std::mt19937_64 random{seed ^ (game * k_seed_stride)};
+          queue.push(play_game(ai, nodes, random));
+        }
+      });
+    }
+  }
+  queue.close();
+  return 0;
+}
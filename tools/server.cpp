@@ -0,0 +1,588 @@
+#include <charconv>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <sstream>
+
+#include "ai.hpp"
+#include "json.hpp"
+#include "san.hpp"
+
+#ifndef _WIN32
+#include <csignal>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr size_t k_default_hash_mb{64};
+constexpr auto k_poll_interval{10ms};
+
+// Where the responses to a client's requests go, stdout without a socket.
+// The socket closes with the last request holding the connection.
+class Connection {
+ public:
+  explicit Connection(int socket = -1) : socket_{socket} {}
+  ~Connection() {
+#ifndef _WIN32
+    if (socket_ >= 0) {
+      ::close(socket_);
+    }
+#endif
+  }
+
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  Connection(Connection&&) = delete;
+  Connection& operator=(Connection&&) = delete;
+
+  void send(std::string line) {
+    line += '\n';
+    const std::scoped_lock lock{mutex_};
+    if (socket_ < 0) {
+      std::cout << line << std::flush;
+      return;
+    }
+#ifndef _WIN32
+    for (size_t offset = 0; offset < line.size();) {
+      const ssize_t size{
+          ::send(socket_, line.data() + offset, line.size() - offset, 0)};
+      if (size <= 0) {
+        return;
+      }
+      offset += static_cast<size_t>(size);
+    }
+#endif
+  }
+
+ private:
+  int socket_;
+  std::mutex mutex_;
+};
+
+struct Request {
+  std::string id;
+  Board board;
+  SearchLimits limits;
+  int priority{};
+  // Order of arrival, ties in priority go first come first served.
+  uint64_t sequence{};
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+  std::shared_ptr<Connection> connection;
+  std::atomic<bool> is_cancelled;
+};
+
+// Reads the 4 hex digits of a \u escape.
+std::optional<uint32_t> parse_hex4(std::string_view text, size_t offset) {
+  if (text.size() - offset < 4) {
+    return std::nullopt;
+  }
+  uint32_t value{};
+  const char* end{text.data() + offset + 4};
+  const auto result{std::from_chars(text.data() + offset, end, value, 16)};
+  return result.ec == std::errc{} && result.ptr == end ? std::optional{value}
+                                                        : std::nullopt;
+}
+
+void append_utf8(std::string& string, uint32_t code_point) {
+  auto append = [&string](uint32_t byte) {
+    string += static_cast<char>(byte);
+  };
+  if (code_point < 0x80) {
+    append(code_point);
+  } else if (code_point < 0x800) {
+    append(0xc0U | (code_point >> 6U));
+    append(0x80U | (code_point & 0x3fU));
+  } else if (code_point < 0x10000) {
+    append(0xe0U | (code_point >> 12U));
+    append(0x80U | ((code_point >> 6U) & 0x3fU));
+    append(0x80U | (code_point & 0x3fU));
+  } else {
+    append(0xf0U | (code_point >> 18U));
+    append(0x80U | ((code_point >> 12U) & 0x3fU));
+    append(0x80U | ((code_point >> 6U) & 0x3fU));
+    append(0x80U | (code_point & 0x3fU));
+  }
+}
+
+// Reads a flat JSON object of strings, numbers and booleans. String values
+// are unescaped, other values are kept as their text.
+std::optional<StringMap<std::string>> parse_object(std::string_view text) {
+  size_t offset{};
+  auto skip_whitespace = [&] {
+    while (offset < text.size() &&
+           std::string_view{" \t\r\n"}.find(text[offset]) !=
+               std::string_view::npos) {
+      offset++;
+    }
+  };
+  auto consume = [&](char c) {
+    skip_whitespace();
+    if (offset < text.size() && text[offset] == c) {
+      offset++;
+      return true;
+    }
+    return false;
+  };
+  // Reads the code point of the \u escape whose u is at offset, joining
+  // surrogate pairs, and leaves offset at its last digit.
+  auto parse_code_point = [&]() -> std::optional<uint32_t> {
+    const auto high{parse_hex4(text, offset + 1)};
+    if (!high || (*high >= 0xdc00 && *high < 0xe000)) {
+      return std::nullopt;
+    }
+    offset += 4;
+    if (*high < 0xd800 || *high >= 0xdc00) {
+      return high;
+    }
+    if (!text.substr(offset + 1).starts_with("\\u")) {
+      return std::nullopt;
+    }
+    const auto low{parse_hex4(text, offset + 3)};
+    if (!low || *low < 0xdc00 || *low >= 0xe000) {
+      return std::nullopt;
+    }
+    offset += 6;
+    return 0x10000 + ((*high - 0xd800) << 10U) + (*low - 0xdc00);
+  };
+  auto parse_string = [&]() -> std::optional<std::string> {
+    if (!consume('"')) {
+      return std::nullopt;
+    }
+    std::string string;
+    for (; offset < text.size() && text[offset] != '"'; offset++) {
+      if (text[offset] == '\\') {
+        if (++offset == text.size()) {
+          return std::nullopt;
+        }
+        switch (text[offset]) {
+          case 'b':
+            string += '\b';
+            break;
+          case 'f':
+            string += '\f';
+            break;
+          case 'n':
+            string += '\n';
+            break;
+          case 'r':
+            string += '\r';
+            break;
+          case 't':
+            string += '\t';
+            break;
+          case 'u':
+            if (const auto code_point = parse_code_point()) {
+              append_utf8(string, *code_point);
+              break;
+            }
+            return std::nullopt;
+          case '"':
+          case '\\':
+          case '/':
+            string += text[offset];
+            break;
+          default:
+            return std::nullopt;
+        }
+      } else {
+        string += text[offset];
+      }
+    }
+    return consume('"') ? std::optional{string} : std::nullopt;
+  };
+
+  StringMap<std::string> object;
+  if (!consume('{')) {
+    return std::nullopt;
+  }
+  if (consume('}')) {
+    return object;
+  }
+  do {
+    const auto key{parse_string()};
+    if (!key || !consume(':')) {
+      return std::nullopt;
+    }
+    skip_whitespace();
+    std::optional<std::string> value;
+    if (offset < text.size() && text[offset] == '"') {
+      value = parse_string();
+    } else {
+      const size_t end{std::min(text.find_first_of(",} \t\r\n", offset),
+                                text.size())};
+      value = std::string{text.substr(offset, end - offset)};
+      offset = end;
+    }
+    if (!value || value->empty()) {
+      return std::nullopt;
+    }
+    object[*key] = std::move(*value);
+  } while (consume(','));
+  if (!consume('}')) {
+    return std::nullopt;
+  }
+  skip_whitespace();
+  return offset == text.size() ? std::optional{object} : std::nullopt;
+}
+
+template <typename T>
+std::optional<T> get_number(const StringMap<std::string>& object,
+                            std::string_view key) {
+  const auto it{object.find(key)};
+  if (it == object.end()) {
+    return std::nullopt;
+  }
+  T number{};
+  const std::string& text{it->second};
+  if (std::from_chars(text.data(), text.data() + text.size(), number).ec !=
+      std::errc{}) {
+    return std::nullopt;
+  }
+  return number;
+}
+
+// Plays space separated moves in coordinate notation or SAN.
+bool play_moves(Board& board, std::string_view moves) {
+  std::istringstream stream{std::string{moves}};
+  std::string token;
+  while (stream >> token) {
+    const auto coordinate_move{parse_move(token)};
+    const auto move{coordinate_move && board.is_legal(*coordinate_move)
+                        ? std::optional<PackedMove>{*coordinate_move}
+                        : parse_san(board, token)};
+    if (!move) {
+      return false;
+    }
+    board.play_move(*move);
+  }
+  return true;
+}
+
+// Schedules requests onto a pool of AIs sharing one transposition table,
+// highest priority first.
+class Server {
+ public:
+  Server(unsigned thread_count, std::shared_ptr<TranspositionTable> table)
+      : table_{std::move(table)} {
+    for (unsigned i = 0; i < thread_count; i++) {
+      workers_.emplace_back(std::bind_front(&Server::work, this));
+    }
+  }
+
+  // Finishes the queued requests first.
+  ~Server() {
+    {
+      const std::scoped_lock lock{mutex_};
+      is_stopping_ = true;
+    }
+    condition_.notify_all();
+  }
+
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  Server(Server&&) = delete;
+  Server& operator=(Server&&) = delete;
+
+  void handle(std::string_view line,
+              const std::shared_ptr<Connection>& connection);
+
+ private:
+  struct ComparePriority {
+    bool operator()(const std::shared_ptr<Request>& left,
+                    const std::shared_ptr<Request>& right) const {
+      return std::tuple{left->priority, right->sequence} <
+             std::tuple{right->priority, left->sequence};
+    }
+  };
+
+  void work();
+  void run(AI& ai, Request& request);
+
+  std::shared_ptr<TranspositionTable> table_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::priority_queue<std::shared_ptr<Request>,
+                      std::vector<std::shared_ptr<Request>>, ComparePriority>
+      queue_;
+  // Queued and running requests by connection and id, so clients cannot
+  // reach each other's requests.
+  std::map<std::pair<const Connection*, std::string>, std::shared_ptr<Request>>
+      requests_;
+  uint64_t sequence_{};
+  bool is_stopping_{};
+  std::vector<std::jthread> workers_;
+};
+
+void Server::handle(std::string_view line,
+                    const std::shared_ptr<Connection>& connection) {
+  const auto object{parse_object(line)};
+  if (!object || !object->contains("id")) {
+    connection->send(
+        R"({"type":"error","message":"Expected an object with an id"})");
+    return;
+  }
+  const std::string& id{object->find("id")->second};
+  auto send_error = [&](std::string_view message) {
+    connection->send(
+        std::format(R"({{"id":"{}","type":"error","message":"{}"}})",
+                    escape_json(id), message));
+  };
+
+  if (const auto it = object->find("cancel");
+      it != object->end() && it->second == "true") {
+    const std::scoped_lock lock{mutex_};
+    if (const auto it = requests_.find({connection.get(), id});
+        it != requests_.end()) {
+      it->second->is_cancelled = true;
+    } else {
+      send_error("Unknown id");
+    }
+    return;
+  }
+
+  auto request{std::make_shared<Request>()};
+  request->id = id;
+  request->connection = connection;
+  if (const auto it = object->find("fen"); it != object->end()) {
+    if (const auto error = request->board.load_fen(it->second)) {
+      send_error(std::format("Invalid FEN: {} at {}", error->message,
+                             error->offset));
+      return;
+    }
+  }
+  if (const auto it = object->find("moves"); it != object->end()) {
+    if (!play_moves(request->board, it->second)) {
+      send_error("Illegal move");
+      return;
+    }
+  }
+  if (request->board.is_in_checkmate() || request->board.is_in_draw()) {
+    send_error("No legal moves");
+    return;
+  }
+
+  SearchLimits& limits{request->limits};
+  const auto depth{get_number<int>(*object, "depth")};
+  limits.nodes = get_number<uint64_t>(*object, "nodes");
+  if (const auto time = get_number<int>(*object, "time_ms")) {
+    limits.time = std::chrono::milliseconds{*time};
+  } else if (depth || limits.nodes) {
+    limits.time.reset();
+  }
+  limits.depth = depth.value_or(limits.depth);
+  limits.multi_pv = get_number<int>(*object, "multi_pv").value_or(1);
+  limits.mate_threads = get_number<unsigned>(*object, "mate").value_or(0);
+  request->priority = get_number<int>(*object, "priority").value_or(0);
+  if (const auto deadline = get_number<int>(*object, "deadline_ms")) {
+    request->deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds{*deadline};
+  }
+  if (limits.depth < 1 || limits.depth >= SearchProgress::k_max_pv_size ||
+      limits.multi_pv < 1 ||
+      limits.mate_threads >
+          std::max(std::thread::hardware_concurrency(), 1U)) {
+    send_error("Invalid limits");
+    return;
+  }
+
+  {
+    const std::scoped_lock lock{mutex_};
+    if (!requests_.emplace(std::pair{connection.get(), id}, request).second) {
+      send_error("Duplicate id");
+      return;
+    }
+    request->sequence = sequence_++;
+    queue_.push(request);
+  }
+  condition_.notify_one();
+}
+
+void Server::work() {
+  AI ai{table_};
+  while (true) {
+    std::shared_ptr<Request> request;
+    {
+      std::unique_lock lock{mutex_};
+      condition_.wait(lock, [this] { return !queue_.empty() || is_stopping_; });
+      if (queue_.empty()) {
+        break;
+      }
+      request = queue_.top();
+      queue_.pop();
+    }
+    run(ai, *request);
+    const std::scoped_lock lock{mutex_};
+    requests_.erase({request->connection.get(), request->id});
+  }
+}
+
+void Server::run(AI& ai, Request& request) {
+  const std::string id{escape_json(request.id)};
+  auto is_past_deadline = [&request] {
+    return request.deadline &&
+           std::chrono::steady_clock::now() >= *request.deadline;
+  };
+  const std::string cancelled{
+      std::format(R"({{"id":"{}","type":"cancelled"}})", id)};
+  if (request.is_cancelled) {
+    request.connection->send(cancelled);
+    return;
+  }
+  if (is_past_deadline()) {
+    request.connection->send(std::format(
+        R"({{"id":"{}","type":"error","message":"Deadline passed"}})", id));
+    return;
+  }
+
+  auto send_progress = [&] {
+    while (const auto progress = ai.poll_progress()) {
+      std::string pv;
+      for (int i = 0; i < progress->pv_size; i++) {
+        pv += std::format(R"({}"{}")", i == 0 ? "" : ",",
+                          to_string(progress->pv[static_cast<size_t>(i)]));
+      }
+      const std::string mate{
+          progress->mate == 0 ? ""
+                              : std::format(R"("mate":{},)", progress->mate)};
+      request.connection->send(std::format(
+          R"({{"id":"{}","type":"info","multi_pv":{},"depth":{},"score":{},)"
+          R"({}"nodes":{},"nps":{},"time_ms":{},"pv":[{}]}})",
+          id, progress->multi_pv, progress->depth, progress->score, mate,
+          progress->nodes, progress->nps, progress->time.count(), pv));
+    }
+  };
+
+  std::future<Move> future{ai.think(request.board, request.limits)};
+  while (future.wait_for(k_poll_interval) != std::future_status::ready) {
+    send_progress();
+    if (request.is_cancelled || is_past_deadline()) {
+      ai.stop();
+    }
+  }
+  send_progress();
+  const Move move{future.get()};
+  if (request.is_cancelled) {
+    request.connection->send(cancelled);
+  } else {
+    request.connection->send(
+        std::format(R"({{"id":"{}","type":"bestmove","move":"{}"}})", id,
+                    to_string(move)));
+  }
+}
+
+#ifndef _WIN32
+bool serve_socket(Server& server, const std::string& path) {
+  const int listener{::socket(AF_UNIX, SOCK_STREAM, 0)};
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (listener < 0 || path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::copy(path.begin(), path.end(), address.sun_path);
+  ::unlink(path.c_str());
+  if (::bind(listener, reinterpret_cast<const sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(listener, SOMAXCONN) != 0) {
+    ::close(listener);
+    return false;
+  }
+  // Writing to a client that went away fails instead of killing the server.
+  std::signal(SIGPIPE, SIG_IGN);
+  LOGF("Server", "Listening on {}", path);
+
+  while (true) {
+    const int client{::accept(listener, nullptr, nullptr)};
+    if (client < 0) {
+      continue;
+    }
+    std::thread{[&server, client] {
+      const auto connection{std::make_shared<Connection>(client)};
+      std::string buffer;
+      std::array<char, 4096> chunk{};
+      ssize_t size{};
+      while ((size = ::recv(client, chunk.data(), chunk.size(), 0)) > 0) {
+        buffer.append(chunk.data(), static_cast<size_t>(size));
+        for (size_t end = buffer.find('\n'); end != std::string::npos;
+             end = buffer.find('\n')) {
+          server.handle(std::string_view{buffer}.substr(0, end), connection);
+          buffer.erase(0, end + 1);
+        }
+      }
+    }}.detach();
+  }
+}
+#endif
+}  // namespace
+
+// Answers JSON-lines analysis requests from stdin, or from clients of a Unix
+// domain socket with --socket. A request looks like
+//   {"id":"a","fen":"...","moves":"e2e4 e7e5","depth":12,"nodes":100000,
+//    "time_ms":1000,"multi_pv":3,"priority":1,"deadline_ms":5000}
+// with every field but the id optional, and {"id":"a","cancel":true} stops
+// it. Responses are info lines for each completed iteration and a bestmove,
+// cancelled or error line. With --shared-hash the transposition table is the
+// named shared memory of every engine process given the same name.
+int main(int argc, char* argv[]) {
+  unsigned thread_count{std::max(std::thread::hardware_concurrency(), 1U)};
+  size_t hash_mb{k_default_hash_mb};
+  std::string socket_path;
+  std::string shared_name;
+  bool is_valid{argc % 2 == 1};
+  for (int i = 1; is_valid && i + 1 < argc; i += 2) {
+    const std::string_view arg{argv[i]};
+    const std::string_view value{argv[i + 1]};
+    const char* last{value.data() + value.size()};
+    auto parse = [&](auto& number) {
+      return std::from_chars(value.data(), last, number).ec == std::errc{} &&
+             number != 0;
+    };
+    if (arg == "--threads") {
+      is_valid = parse(thread_count);
+    } else if (arg == "--hash") {
+      is_valid = parse(hash_mb);
+    } else if (arg == "--socket") {
+      socket_path = value;
+    } else if (arg == "--shared-hash") {
+      shared_name = value;
+    } else {
+      is_valid = false;
+    }
+  }
+  if (!is_valid) {
+    std::cerr << "usage: chess-server [--threads N] [--hash MB] "
+                 "[--shared-hash NAME] [--socket PATH]\n";
+    return 1;
+  }
+
+  const auto table{
+      shared_name.empty()
+          ? std::make_shared<TranspositionTable>(hash_mb)
+          : std::make_shared<TranspositionTable>(shared_name, hash_mb)};
+  if (!shared_name.empty() && !table->is_shared()) {
+    std::cerr << std::format("Failed to open shared hash {}\n", shared_name);
+    return 1;
+  }
+  Server server{thread_count, table};
+  if (!socket_path.empty()) {
+#ifndef _WIN32
+    if (!serve_socket(server, socket_path)) {
+      std::cerr << std::format("Failed to listen on {}\n", socket_path);
+    }
+#else
+    std::cerr << "Sockets are not supported on Windows\n";
+#endif
+    return 1;
+  }
+
+  const auto connection{std::make_shared<Connection>()};
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    server.handle(line, connection);
+  }
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include <charconv>
+#include <iostream>
+
+#include "tablebase.hpp"
+
+namespace {
+constexpr std::string_view k_default_directory{"tablebases"};
+}  // namespace
+
+// Generates the tables of the given materials and of every ending they
+// convert into, skipping tables already in the directory.
+int main(int argc, char* argv[]) {
+  unsigned thread_count{std::max(std::thread::hardware_concurrency(), 1U)};
+  std::filesystem::path directory{k_default_directory};
+  int i{1};
+  bool is_valid{true};
+  for (; is_valid && i + 1 < argc &&
+         std::string_view{argv[i]}.starts_with("--");
+       i += 2) {
+    const std::string_view arg{argv[i]};
+    const std::string_view value{argv[i + 1]};
+    if (arg == "--threads") {
+      is_valid = std::from_chars(value.data(), value.data() + value.size(),
+                                 thread_count)
+                         .ec == std::errc{} &&
+                 thread_count != 0;
+    } else if (arg == "--output") {
+      directory = value;
+    } else {
+      is_valid = false;
+    }
+  }
+  if (!is_valid || i == argc) {
+    std::cerr << "usage: chess-tablebase [--threads N] [--output DIR] "
+                 "MATERIAL...\n";
+    return 1;
+  }
+
+  Tablebase tablebase;
+  tablebase.load(directory);
+  const size_t loaded{tablebase.size()};
+  const auto start{std::chrono::high_resolution_clock::now()};
+  for (; i < argc; i++) {
+    if (!tablebase.generate(argv[i], directory, thread_count)) {
+      std::cerr << std::format("Failed to generate {}\n", argv[i]);
+      return 1;
+    }
+  }
+  std::cout << std::format(
+      "Generated {} tables in {}ms\n", tablebase.size() - loaded,
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::high_resolution_clock::now() - start)
+          .count());
+  return 0;
+}
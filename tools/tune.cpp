@@ -0,0 +1,349 @@
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "board.hpp"
+#include "epd.hpp"
+#include "evaluation_tables.hpp"
+#include "packed_position_file.hpp"
+
+namespace {
+constexpr int k_default_epochs{100};
+constexpr double k_default_learning_rate{1.0};
+constexpr int k_scale_iterations{40};
+constexpr double k_max_scale{5.0};
+
+// Adam
+constexpr double k_beta1{0.9};
+constexpr double k_beta2{0.999};
+constexpr double k_epsilon{1e-8};
+
+// Parameters of the linear form of AI::evaluate, the piece values followed by
+// one table of 64 tiles per piece type, both indexed by PieceType.
+constexpr size_t k_piece_count{7};
+constexpr size_t k_table_offset{k_piece_count};
+constexpr size_t k_parameter_count{k_table_offset + k_piece_count * 64};
+using Parameters = std::vector<double>;
+
+struct Table {
+  std::string_view name;
+  PieceType type;
+  const std::array<int, 64>& values;
+};
+
+// In the order of evaluation_tables.hpp.
+const std::array k_tables{
+    Table{"k_pawn_table", PieceType::Pawn, k_pawn_table},
+    Table{"k_knight_table", PieceType::Knight, k_knight_table},
+    Table{"k_bishop_table", PieceType::Bishop, k_bishop_table},
+    Table{"k_rook_table", PieceType::Rook, k_rook_table},
+    Table{"k_queen_table", PieceType::Queen, k_queen_table},
+    Table{"k_king_table", PieceType::King, k_king_table},
+};
+
+size_t get_table_index(PieceType type, int tile) {
+  return k_table_offset + to_underlying(type) * size_t{64} +
+         static_cast<size_t>(tile);
+}
+
+// Calls visit with every parameter and its coefficient in the evaluation from
+// white's point of view. Unlike AI::evaluate it does not know about mates and
+// draws.
+template <typename Visit>
+void for_each_feature(const PackedPosition& position, Visit visit) {
+  Bitboard occupancy{position.occupancy};
+  for (size_t i = 0; occupancy != 0; i++) {
+    const int tile{pop_tile(occupancy)};
+    const unsigned code{
+        static_cast<unsigned>(position.pieces[i / 2] >> (4 * (i % 2))) & 15U};
+    const auto type{static_cast<PieceType>(code & 7U)};
+    const bool is_black{(code & 8U) != 0};
+    // White reads the tables upside down, as AI::evaluate does.
+    const int table_tile{is_black ? tile
+                                  : 8 * (7 - get_tile_row(tile)) +
+                                        get_tile_column(tile)};
+    const double sign{is_black ? -1.0 : 1.0};
+    visit(static_cast<size_t>(to_underlying(type)), sign);
+    visit(get_table_index(type, table_tile), sign);
+  }
+}
+
+// Expected score of white for a centipawn evaluation.
+double get_win_probability(double scale, double score) {
+  return 1.0 / (1.0 + std::pow(10.0, -scale * score / 400.0));
+}
+
+// Mean squared error of the win probabilities against the results, adding
+// its gradient to gradient unless it is empty. The positions are split evenly
+// between the threads, each summing into its own gradient.
+double run_pass(std::span<const PackedPosition> positions,
+                const Parameters& parameters, double scale,
+                Parameters& gradient, unsigned thread_count) {
+  const bool has_gradient{!gradient.empty()};
+  std::vector<double> errors(thread_count);
+  std::vector<Parameters> gradients(
+      thread_count, Parameters(has_gradient ? k_parameter_count : 0));
+  {
+    std::vector<std::jthread> threads;
+    for (unsigned thread = 0; thread < thread_count; thread++) {
+      threads.emplace_back([&, thread] {
+        const size_t begin{positions.size() * thread / thread_count};
+        const size_t end{positions.size() * (thread + 1) / thread_count};
+        Parameters& thread_gradient{gradients[thread]};
+        double error_sum{};
+        for (size_t i = begin; i < end; i++) {
+          double score{};
+          for_each_feature(positions[i], [&](size_t parameter, double sign) {
+            score += sign * parameters[parameter];
+          });
+          const double probability{get_win_probability(scale, score)};
+          const double error{probability -
+                             (positions[i].result + 1) / 2.0};
+          error_sum += error * error;
+          if (has_gradient) {
+            const double slope{error * probability * (1.0 - probability)};
+            for_each_feature(positions[i], [&](size_t parameter, double sign) {
+              thread_gradient[parameter] += slope * sign;
+            });
+          }
+        }
+        errors[thread] = error_sum;
+      });
+    }
+  }
+
+  const auto count{static_cast<double>(positions.size())};
+  if (has_gradient) {
+    const double factor{2.0 * scale * std::log(10.0) / 400.0 / count};
+    for (const Parameters& thread_gradient : gradients) {
+      for (size_t i = 0; i < k_parameter_count; i++) {
+        gradient[i] += thread_gradient[i] * factor;
+      }
+    }
+  }
+  double error{};
+  for (const double thread_error : errors) {
+    error += thread_error;
+  }
+  return error / count;
+}
+
+// The scale that fits the current evaluation best, by golden section search.
+double fit_scale(std::span<const PackedPosition> positions,
+                 const Parameters& parameters, unsigned thread_count) {
+  const double ratio{(std::sqrt(5.0) - 1.0) / 2.0};
+  Parameters no_gradient;
+  auto get_error = [&](double scale) {
+    return run_pass(positions, parameters, scale, no_gradient, thread_count);
+  };
+  double low{};
+  double high{k_max_scale};
+  for (int i = 0; i < k_scale_iterations; i++) {
+    const double left{high - ratio * (high - low)};
+    const double right{low + ratio * (high - low)};
+    if (get_error(left) < get_error(right)) {
+      high = right;
+    } else {
+      low = left;
+    }
+  }
+  return (low + high) / 2.0;
+}
+
+Parameters get_initial_parameters() {
+  Parameters parameters(k_parameter_count);
+  for (size_t i = 0; i < k_piece_count; i++) {
+    parameters[i] = k_piece_values[i];
+  }
+  for (const Table& table : k_tables) {
+    for (int tile = 0; tile < 64; tile++) {
+      parameters[get_table_index(table.type, tile)] =
+          table.values[static_cast<size_t>(tile)];
+    }
+  }
+  return parameters;
+}
+
+int round_parameter(double parameter) {
+  return static_cast<int>(std::lround(parameter));
+}
+
+std::string to_header(const Parameters& parameters) {
+  std::string header{
+      "#pragma once\n"
+      "\n"
+      "#include <array>\n"
+      "\n"
+      "// Generated by chess-tune. The piece values are indexed by PieceType, "
+      "the\n"
+      "// tables read like a board seen from their side with its back rank "
+      "last.\n"
+      "\n"
+      "// clang-format off\n"
+      "inline constexpr std::array k_piece_values{"};
+  for (size_t i = 0; i < k_piece_count; i++) {
+    header += std::format("{}{}", i == 0 ? "" : ", ",
+                          round_parameter(parameters[i]));
+  }
+  header += "};\n";
+
+  for (const Table& table : k_tables) {
+    header += std::format("\ninline constexpr std::array {}{{\n", table.name);
+    for (int tile = 0; tile < 64; tile++) {
+      header += std::format(
+          "{:>4}{}", round_parameter(parameters[get_table_index(table.type,
+                                                                tile)]),
+          tile == 63 ? "\n" : tile % 8 == 7 ? ",\n" : ",");
+    }
+    header += "};\n";
+  }
+  header += "// clang-format on\n";
+  return header;
+}
+
+// Reads packed positions from .bin files and EPD lines with a c9 result from
+// any other file.
+bool load_positions(const std::filesystem::path& path,
+                    std::vector<PackedPosition>& positions) {
+  if (path.extension() == ".bin") {
+    const PackedPositionReader reader{path};
+    Board board;
+    size_t skipped{};
+    for (const PackedPosition& position : reader.get_positions()) {
+      if (board.load_packed(position)) {
+        positions.push_back(position);
+      } else {
+        skipped++;
+      }
+    }
+    if (skipped != 0) {
+      LOGF("Tune", "Skipped {} invalid packed positions in {}", skipped,
+           path.string());
+    }
+    return reader.is_open();
+  }
+
+  EpdReader reader{path};
+  Board board;
+  size_t skipped{};
+  while (const auto record = reader.next()) {
+    std::optional<int8_t> result;
+    if (record->result == "1-0") {
+      result = 1;
+    } else if (record->result == "0-1") {
+      result = -1;
+    } else if (record->result == "1/2-1/2") {
+      result = 0;
+    }
+    std::optional<PackedPosition> packed;
+    if (result && !board.load_fen(record->fen)) {
+      packed = board.to_packed();
+    }
+    if (!packed) {
+      skipped++;
+      continue;
+    }
+    positions.push_back(*packed);
+    positions.back().result = *result;
+  }
+  if (skipped != 0) {
+    LOGF("Tune", "Skipped {} lines without a result or a valid FEN in {}",
+         skipped, path.string());
+  }
+  return reader.is_open();
+}
+}  // namespace
+
+// Fits the piece values and tables to the game results of labelled positions
+// by gradient descent on the Texel error, and writes them as
+// evaluation_tables.hpp.
+int main(int argc, char* argv[]) {
+  int epochs{k_default_epochs};
+  double learning_rate{k_default_learning_rate};
+  std::optional<double> scale;
+  std::string output_path{"evaluation_tables.hpp"};
+  std::vector<PackedPosition> positions;
+  bool is_valid{argc > 1};
+  for (int i = 1; is_valid && i < argc; i++) {
+    const std::string_view arg{argv[i]};
+    if (arg.starts_with("--")) {
+      if (i + 1 == argc) {
+        is_valid = false;
+        break;
+      }
+      const std::string_view value{argv[++i]};
+      const char* last{value.data() + value.size()};
+      if (arg == "--epochs") {
+        is_valid = std::from_chars(value.data(), last, epochs).ec ==
+                       std::errc{} &&
+                   epochs >= 0;
+      } else if (arg == "--learning-rate") {
+        is_valid = std::from_chars(value.data(), last, learning_rate).ec ==
+                   std::errc{};
+      } else if (arg == "--scale") {
+        scale = 0.0;
+        is_valid =
+            std::from_chars(value.data(), last, *scale).ec == std::errc{};
+      } else if (arg == "--output") {
+        output_path = value;
+      } else {
+        is_valid = false;
+      }
+    } else if (!load_positions(arg, positions)) {
+      std::cerr << std::format("Failed to read {}\n", arg);
+      return 1;
+    }
+  }
+  if (!is_valid) {
+    std::cerr << "usage: chess-tune [--epochs N] [--learning-rate CP] "
+                 "[--scale K] [--output FILE] POSITIONS...\n";
+    return 1;
+  }
+  if (positions.empty()) {
+    std::cerr << "No labelled positions\n";
+    return 1;
+  }
+
+  const unsigned thread_count{
+      std::max(std::thread::hardware_concurrency(), 1U)};
+  Parameters parameters{get_initial_parameters()};
+  if (!scale) {
+    scale = fit_scale(positions, parameters, thread_count);
+  }
+  std::cout << std::format("{} positions, scale {:.4f}\n", positions.size(),
+                           *scale);
+
+  Parameters gradient(k_parameter_count);
+  Parameters first_moments(k_parameter_count);
+  Parameters second_moments(k_parameter_count);
+  for (int epoch = 1; epoch <= epochs; epoch++) {
+    const auto start{std::chrono::high_resolution_clock::now()};
+    std::fill(gradient.begin(), gradient.end(), 0.0);
+    const double error{
+        run_pass(positions, parameters, *scale, gradient, thread_count)};
+    for (size_t i = 0; i < k_parameter_count; i++) {
+      first_moments[i] =
+          k_beta1 * first_moments[i] + (1.0 - k_beta1) * gradient[i];
+      second_moments[i] = k_beta2 * second_moments[i] +
+                          (1.0 - k_beta2) * gradient[i] * gradient[i];
+      const double first{first_moments[i] / (1.0 - std::pow(k_beta1, epoch))};
+      const double second{second_moments[i] /
+                          (1.0 - std::pow(k_beta2, epoch))};
+      parameters[i] -= learning_rate * first / (std::sqrt(second) + k_epsilon);
+    }
+    const auto time{std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - start)};
+    std::cout << std::format("Epoch {:>4}: error {:.6f} {}ms\n", epoch, error,
+                             time.count());
+  }
+
+  std::ofstream file{output_path};
+  file << to_header(parameters);
+  if (!file) {
+    std::cerr << std::format("Failed to write {}\n", output_path);
+    return 1;
+  }
+  return 0;
+}